@@ -0,0 +1,14 @@
+#pragma once
+
+#include "Chip8Aot.h"
+
+#include <string>
+
+// The ROMs the CMake build compiles ahead of time, see CMakeLists.txt. Only CMake builds have them, and they define
+// CHIP8_AOT_PROGRAMS for whatever links them.
+class AotPrograms
+{
+public:
+	// The program compiled from the ROM with this file name, e.g. "BRIX", or nullptr if there is none
+	static const Chip8Aot::Program* find(const std::string& romName);
+};
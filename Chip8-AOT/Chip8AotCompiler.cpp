@@ -0,0 +1,431 @@
+#include "Chip8AotCompiler.h"
+
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+	std::string hex(unsigned value, int width)
+	{
+		std::ostringstream text{};
+		text << "0x" << std::uppercase << std::hex << std::setw(width) << std::setfill('0') << value;
+		return text.str();
+	}
+
+	const char* platformName(Chip8::Platform platform)
+	{
+		switch (platform)
+		{
+		case Chip8::Platform::CosmacVip:
+			return "CosmacVip";
+		case Chip8::Platform::XoChip:
+			return "XoChip";
+		default:
+			return "SuperChip";
+		}
+	}
+
+	std::string v(int reg)
+	{
+		std::ostringstream text{};
+		text << 'v' << std::uppercase << std::hex << reg;
+		return text.str();
+	}
+}
+
+Chip8AotCompiler::Chip8AotCompiler(const Chip8& chip8)
+	: chip8{ chip8 }
+{
+	romEnd = Chip8::MEM_START;
+	for (std::size_t i{ Chip8::MEM_START }; i < Chip8::MEMORY_SIZE; ++i)
+	{
+		if (chip8.memory[i] != 0) romEnd = i + 1;
+	}
+}
+
+bool Chip8AotCompiler::endsBlock(Chip8::Op op)
+{
+	switch (op)
+	{
+	case Chip8::Op::OP_00EE:
+	case Chip8::Op::OP_1NNN:
+	case Chip8::Op::OP_2NNN:
+	case Chip8::Op::OP_3XNN:
+	case Chip8::Op::OP_4XNN:
+	case Chip8::Op::OP_5XY0:
+	case Chip8::Op::OP_9XY0:
+	case Chip8::Op::OP_BNNN:
+	case Chip8::Op::OP_EX9E:
+	case Chip8::Op::OP_EXA1:
+	case Chip8::Op::OP_FX07:
+	case Chip8::Op::OP_FX0A:
+	case Chip8::Op::OP_FX15:
+	case Chip8::Op::OP_FX18:
+	case Chip8::Op::OP_FX33:
+	case Chip8::Op::OP_FX55:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Instructions that touch the stack, display, keypad, RNG or memory are left to their handlers
+bool Chip8AotCompiler::callsHandler(Chip8::Op op)
+{
+	switch (op)
+	{
+	case Chip8::Op::OP_00E0:
+	case Chip8::Op::OP_00EE:
+	case Chip8::Op::OP_2NNN:
+	case Chip8::Op::OP_BNNN:
+	case Chip8::Op::OP_CXNN:
+	case Chip8::Op::OP_DXYN:
+	case Chip8::Op::OP_EX9E:
+	case Chip8::Op::OP_EXA1:
+	case Chip8::Op::OP_FX0A:
+	case Chip8::Op::OP_FX33:
+	case Chip8::Op::OP_FX55:
+	case Chip8::Op::OP_FX65:
+		return true;
+	default:
+		return false;
+	}
+}
+
+Chip8AotCompiler::Block Chip8AotCompiler::scanBlock(std::uint16_t address, std::vector<std::uint16_t>& successors)
+{
+	Block block{};
+	block.start = address;
+
+	std::uint16_t pc{ address };
+	while (block.opcodes.size() < MAX_BLOCK_LENGTH && pc < romEnd && pc <= Chip8::MEMORY_SIZE - 2)
+	{
+		std::uint16_t opcode{ static_cast<std::uint16_t>((chip8.memory[pc] << 8) | chip8.memory[pc + 1]) };
+		Chip8::Instruction inst{ Chip8::decodeInstruction(opcode) };
+		block.opcodes.push_back(opcode);
+		pc += 2;
+
+		switch (inst.op)
+		{
+		case Chip8::Op::OP_1NNN:
+			successors.push_back(inst.nnn);
+			break;
+		case Chip8::Op::OP_2NNN:
+			// 00EE comes back to the instruction after the call
+			successors.push_back(inst.nnn);
+			successors.push_back(pc);
+			break;
+		case Chip8::Op::OP_3XNN:
+		case Chip8::Op::OP_4XNN:
+		case Chip8::Op::OP_5XY0:
+		case Chip8::Op::OP_9XY0:
+		case Chip8::Op::OP_EX9E:
+		case Chip8::Op::OP_EXA1:
+			successors.push_back(pc);
+			successors.push_back(pc + 2);
+			break;
+		case Chip8::Op::OP_FX0A:
+			successors.push_back(pc - 2);
+			successors.push_back(pc);
+			break;
+		case Chip8::Op::OP_BNNN:
+			computedJumpSites.insert(static_cast<std::uint16_t>(pc - 2));
+			break;
+		case Chip8::Op::OP_00EE:
+			break;
+		default:
+			if (endsBlock(inst.op)) successors.push_back(pc);
+			break;
+		}
+
+		if (endsBlock(inst.op)) break;
+	}
+
+	// Ran into the block limit or the end of the ROM without a branch
+	if (block.opcodes.empty() || !endsBlock(Chip8::decodeTable[block.opcodes.back()]))
+	{
+		successors.push_back(pc);
+	}
+
+	block.end = pc;
+	return block;
+}
+
+std::size_t Chip8AotCompiler::trace()
+{
+	blocks.clear();
+	computedJumpSites.clear();
+
+	std::vector<std::uint16_t> pending{ static_cast<std::uint16_t>(Chip8::MEM_START) };
+	while (!pending.empty())
+	{
+		std::uint16_t address{ pending.back() };
+		pending.pop_back();
+
+		if (address < Chip8::MEM_START || address >= romEnd || blocks.count(address)) continue;
+
+		std::vector<std::uint16_t> successors{};
+		Block block{ scanBlock(address, successors) };
+		if (block.opcodes.empty()) continue;
+
+		blocks.emplace(address, block);
+		pending.insert(pending.end(), successors.begin(), successors.end());
+	}
+
+	return blocks.size();
+}
+
+void Chip8AotCompiler::emitBlock(std::ostream& out, const Block& block) const
+{
+	// Registers used by inline code are kept in locals for the whole block
+	std::uint16_t usedV{ 0 };
+	bool usesIr{ false };
+	for (std::uint16_t opcode : block.opcodes)
+	{
+		Chip8::Instruction inst{ Chip8::decodeInstruction(opcode) };
+		if (callsHandler(inst.op)) continue;
+
+		switch (inst.op)
+		{
+		case Chip8::Op::OP_ANNN:
+			usesIr = true;
+			break;
+		case Chip8::Op::OP_3XNN:
+		case Chip8::Op::OP_4XNN:
+		case Chip8::Op::OP_6XNN:
+		case Chip8::Op::OP_7XNN:
+		case Chip8::Op::OP_FX07:
+		case Chip8::Op::OP_FX15:
+		case Chip8::Op::OP_FX18:
+			usedV |= (1 << inst.x);
+			break;
+		case Chip8::Op::OP_5XY0:
+		case Chip8::Op::OP_9XY0:
+		case Chip8::Op::OP_8XY0:
+		case Chip8::Op::OP_8XY1:
+		case Chip8::Op::OP_8XY2:
+		case Chip8::Op::OP_8XY3:
+			usedV |= (1 << inst.x) | (1 << inst.y);
+			break;
+		case Chip8::Op::OP_8XY4:
+		case Chip8::Op::OP_8XY5:
+		case Chip8::Op::OP_8XY7:
+			usedV |= (1 << inst.x) | (1 << inst.y) | (1 << 0xF);
+			break;
+		case Chip8::Op::OP_8XY6:
+		case Chip8::Op::OP_8XYE:
+			usedV |= (1 << inst.x) | (1 << 0xF);
+			if (chip8.profile->shiftUsesY) usedV |= (1 << inst.y);
+			break;
+		case Chip8::Op::OP_FX1E:
+			usesIr = true;
+			usedV |= (1 << inst.x) | (1 << 0xF);
+			break;
+		case Chip8::Op::OP_FX29:
+			usesIr = true;
+			usedV |= (1 << inst.x);
+			break;
+		default:
+			break;
+		}
+	}
+
+	std::uint16_t dirtyV{ 0 };
+	bool dirtyIr{ false };
+
+	auto load = [&](const char* indent)
+	{
+		for (int i{ 0 }; i < 16; ++i)
+		{
+			if (usedV & (1 << i)) out << indent << v(i) << " = m.registers[" << hex(i, 1) << "];\n";
+		}
+		if (usesIr) out << indent << "ir = m.ir;\n";
+	};
+	auto store = [&](const char* indent)
+	{
+		for (int i{ 0 }; i < 16; ++i)
+		{
+			if (dirtyV & (1 << i)) out << indent << "m.registers[" << hex(i, 1) << "] = " << v(i) << ";\n";
+		}
+		if (dirtyIr) out << indent << "m.ir = ir;\n";
+		dirtyV = 0;
+		dirtyIr = false;
+	};
+
+	out << "\t// " << hex(block.start, 3) << " - " << hex(block.end, 3) << '\n';
+	out << "\tvoid block_" << std::hex << std::uppercase << block.start << std::dec << "(Chip8Aot::Machine& m)\n\t{\n";
+
+	for (int i{ 0 }; i < 16; ++i)
+	{
+		if (usedV & (1 << i)) out << "\t\tstd::uint8_t " << v(i) << "{ m.registers[" << hex(i, 1) << "] };\n";
+	}
+	if (usesIr) out << "\t\tstd::uint16_t ir{ m.ir };\n";
+	if (usedV || usesIr) out << '\n';
+
+	bool pcSet{ false };
+	std::uint16_t pc{ block.start };
+	for (std::uint16_t opcode : block.opcodes)
+	{
+		Chip8::Instruction inst{ Chip8::decodeInstruction(opcode) };
+		pc += 2;
+
+		const std::string vx{ v(inst.x) };
+		const std::string vy{ v(inst.y) };
+		const std::string nn{ hex(inst.nn, 2) };
+		const std::string comment{ "\t// " + hex(opcode, 4).substr(2) + '\n' };
+
+		if (callsHandler(inst.op))
+		{
+			store("\t\t");
+			out << "\t\tm.call(" << hex(opcode, 4) << ", " << hex(pc, 3) << ");" << comment;
+			if (endsBlock(inst.op)) pcSet = true;
+			else load("\t\t");
+			continue;
+		}
+
+		// Each statement follows its opcode_XXXX handler, including the order VF is written in
+		switch (inst.op)
+		{
+		case Chip8::Op::OP_1NNN:
+			store("\t\t");
+			out << "\t\tm.pc = " << hex(inst.nnn, 3) << ';' << comment;
+			pcSet = true;
+			break;
+		case Chip8::Op::OP_3XNN:
+		case Chip8::Op::OP_4XNN:
+		case Chip8::Op::OP_5XY0:
+		case Chip8::Op::OP_9XY0:
+		{
+			const char* compare{ (inst.op == Chip8::Op::OP_3XNN || inst.op == Chip8::Op::OP_5XY0) ? " == " : " != " };
+			const std::string rhs{ (inst.op == Chip8::Op::OP_3XNN || inst.op == Chip8::Op::OP_4XNN) ? nn : vy };
+			store("\t\t");
+			out << "\t\tm.pc = (" << vx << compare << rhs << ") ? " << hex(pc + 2, 3) << " : " << hex(pc, 3) << ';' << comment;
+			pcSet = true;
+			break;
+		}
+		case Chip8::Op::OP_6XNN:
+			out << "\t\t" << vx << " = " << nn << ';' << comment;
+			dirtyV |= 1 << inst.x;
+			break;
+		case Chip8::Op::OP_7XNN:
+			out << "\t\t" << vx << " = static_cast<std::uint8_t>(" << vx << " + " << nn << ");" << comment;
+			dirtyV |= 1 << inst.x;
+			break;
+		case Chip8::Op::OP_8XY0:
+			out << "\t\t" << vx << " = " << vy << ';' << comment;
+			dirtyV |= 1 << inst.x;
+			break;
+		case Chip8::Op::OP_8XY1:
+			out << "\t\t" << vx << " = static_cast<std::uint8_t>(" << vx << " | " << vy << ");" << comment;
+			dirtyV |= 1 << inst.x;
+			break;
+		case Chip8::Op::OP_8XY2:
+			out << "\t\t" << vx << " = static_cast<std::uint8_t>(" << vx << " & " << vy << ");" << comment;
+			dirtyV |= 1 << inst.x;
+			break;
+		case Chip8::Op::OP_8XY3:
+			out << "\t\t" << vx << " = static_cast<std::uint8_t>(" << vx << " ^ " << vy << ");" << comment;
+			dirtyV |= 1 << inst.x;
+			break;
+		case Chip8::Op::OP_8XY4:
+			out << "\t\t{ int result{ " << vx << " + " << vy << " }; vF = (result > 255); "
+				<< vx << " = static_cast<std::uint8_t>(result); }" << comment;
+			dirtyV |= (1 << inst.x) | (1 << 0xF);
+			break;
+		case Chip8::Op::OP_8XY5:
+			out << "\t\tvF = (" << vx << " > " << vy << "); "
+				<< vx << " = static_cast<std::uint8_t>(" << vx << " - " << vy << ");" << comment;
+			dirtyV |= (1 << inst.x) | (1 << 0xF);
+			break;
+		case Chip8::Op::OP_8XY7:
+			out << "\t\tvF = (" << vy << " > " << vx << "); "
+				<< vx << " = static_cast<std::uint8_t>(" << vy << " - " << vx << ");" << comment;
+			dirtyV |= (1 << inst.x) | (1 << 0xF);
+			break;
+		case Chip8::Op::OP_8XY6:
+		case Chip8::Op::OP_8XYE:
+		{
+			const bool right{ inst.op == Chip8::Op::OP_8XY6 };
+			out << "\t\t";
+			if (chip8.profile->shiftUsesY) out << vx << " = " << vy << "; ";
+			out << "vF = " << (right ? "(" + vx + " & 0x1)" : "((" + vx + " & 0x80) >> 7)") << "; "
+				<< vx << " = static_cast<std::uint8_t>(" << vx << (right ? " >> 1" : " << 1") << ");" << comment;
+			dirtyV |= (1 << inst.x) | (1 << 0xF);
+			break;
+		}
+		case Chip8::Op::OP_ANNN:
+			out << "\t\tir = " << hex(inst.nnn, 3) << ';' << comment;
+			dirtyIr = true;
+			break;
+		case Chip8::Op::OP_FX07:
+			out << "\t\t" << vx << " = m.delayTimer;" << comment;
+			dirtyV |= 1 << inst.x;
+			break;
+		case Chip8::Op::OP_FX15:
+			out << "\t\tm.delayTimer = " << vx << ';' << comment;
+			break;
+		case Chip8::Op::OP_FX18:
+			out << "\t\tm.soundTimer = " << vx << ';' << comment;
+			break;
+		case Chip8::Op::OP_FX1E:
+			out << "\t\t{ int result{ ir + " << vx << " }; vF = (result > 0xFFF); ir = static_cast<std::uint16_t>(result); }" << comment;
+			dirtyV |= 1 << 0xF;
+			dirtyIr = true;
+			break;
+		case Chip8::Op::OP_FX29:
+			out << "\t\tir = static_cast<std::uint16_t>(" << hex(Chip8::FONTCHAR_START, 2) << " + (5 * " << vx << "));" << comment;
+			dirtyIr = true;
+			break;
+		default:
+			out << "\t\t// " << hex(opcode, 4).substr(2) << " ignored\n";
+			break;
+		}
+	}
+
+	store("\t\t");
+	if (!pcSet) out << "\t\tm.pc = " << hex(block.end, 3) << ";\n";
+	out << "\t}\n\n";
+}
+
+void Chip8AotCompiler::emit(std::ostream& out, const std::string& programName, const std::string& romName) const
+{
+	std::size_t imageEnd{ romEnd };
+	std::size_t instructions{ 0 };
+	for (const auto& [address, block] : blocks)
+	{
+		imageEnd = std::max<std::size_t>(imageEnd, block.end);
+		instructions += block.opcodes.size();
+	}
+
+	out << "// Generated by Chip8-AOT from " << romName << ", do not edit.\n";
+	out << "// " << blocks.size() << " blocks, " << instructions << " instructions, "
+		<< computedJumpSites.size() << " computed jumps left to the interpreter.\n";
+	out << "//\n// Use with:\n//\textern const Chip8Aot::Program " << programName << ";\n";
+	out << "//\tChip8Aot aot{ chip8, " << programName << " };\n\n";
+	out << "#include \"Chip8Aot.h\"\n\n#include <cstdint>\n\n";
+	out << "namespace\n{\n";
+
+	out << "\tconst std::uint8_t romImage[]\n\t{";
+	for (std::size_t i{ Chip8::MEM_START }; i < imageEnd; ++i)
+	{
+		if ((i - Chip8::MEM_START) % 16 == 0) out << "\n\t\t";
+		out << hex(chip8.memory[i], 2) << ", ";
+	}
+	out << "\n\t};\n\n";
+
+	for (const auto& [address, block] : blocks) emitBlock(out, block);
+
+	out << "\tconst Chip8Aot::Block blocks[]\n\t{\n";
+	for (const auto& [address, block] : blocks)
+	{
+		out << "\t\t{ " << hex(block.start, 3) << ", " << hex(block.end, 3) << ", " << std::dec << block.opcodes.size()
+			<< ", &block_" << std::hex << std::uppercase << block.start << std::dec << " },\n";
+	}
+	out << "\t};\n}\n\n";
+
+	out << "extern const Chip8Aot::Program " << programName << "\n{\n";
+	out << "\t\"" << romName << "\",\n";
+	out << "\tChip8::Platform::" << platformName(chip8.getPlatform()) << ",\n";
+	out << "\tromImage,\n\tsizeof(romImage),\n";
+	out << "\tblocks,\n\tsizeof(blocks) / sizeof(blocks[0])\n};\n";
+}
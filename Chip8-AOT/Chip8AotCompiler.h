@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Chip8.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+// Traces the control flow of a loaded ROM and emits it as a C++ translation unit for Chip8Aot
+class Chip8AotCompiler
+{
+public:
+	explicit Chip8AotCompiler(const Chip8& chip8);
+
+	// Follow every statically known branch from 0x200, returns the number of blocks found
+	std::size_t trace();
+
+	void emit(std::ostream& out, const std::string& programName, const std::string& romName) const;
+
+	std::size_t computedJumps() const
+	{
+		return computedJumpSites.size();
+	}
+
+private:
+	struct Block
+	{
+		std::uint16_t start{};
+		std::uint16_t end{};
+		std::vector<std::uint16_t> opcodes{};
+	};
+
+	static constexpr std::size_t MAX_BLOCK_LENGTH{ 256 };
+
+	const Chip8& chip8;
+	std::size_t romEnd{};		// One past the last non-zero ROM byte
+
+	std::map<std::uint16_t, Block> blocks{};
+	std::set<std::uint16_t> computedJumpSites{};
+
+	static bool endsBlock(Chip8::Op op);
+	static bool callsHandler(Chip8::Op op);
+
+	Block scanBlock(std::uint16_t address, std::vector<std::uint16_t>& successors);
+	void emitBlock(std::ostream& out, const Block& block) const;
+};
@@ -0,0 +1,58 @@
+#include "Chip8.h"
+#include "Chip8AotCompiler.h"
+
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+// Turn a ROM path into a usable C++ identifier, e.g. "roms/15 PUZZLE" -> "rom_15_PUZZLE"
+std::string programNameFor(const std::string& romPath)
+{
+	std::string name{ romPath.substr(romPath.find_last_of("/\\") + 1) };
+	name = name.substr(0, name.find('.'));
+
+	for (char& c : name)
+	{
+		if (!std::isalnum(static_cast<unsigned char>(c))) c = '_';
+	}
+
+	return "rom_" + name;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		std::cout << "Usage: Chip8-AOT <rom> <output.cpp> [program name]" << std::endl;
+		return 1;
+	}
+
+	std::string romPath{ argv[1] };
+	std::string outputPath{ argv[2] };
+	std::string programName{ (argc > 3) ? argv[3] : programNameFor(romPath) };
+
+	auto chip8{ std::make_unique<Chip8>() };
+	if (!chip8->loadRom(romPath)) return 1;
+
+	Chip8AotCompiler compiler{ *chip8 };
+	std::size_t blockCount{ compiler.trace() };
+
+	std::ofstream output{ outputPath };
+	if (!output)
+	{
+		std::cout << "Failed to open " << outputPath << std::endl;
+		return 1;
+	}
+
+	compiler.emit(output, programName, romPath.substr(romPath.find_last_of("/\\") + 1));
+
+	std::cout << std::dec << "\nWrote " << blockCount << " blocks to " << outputPath << " as " << programName << std::endl;
+	if (compiler.computedJumps() > 0)
+	{
+		std::cout << compiler.computedJumps() << " computed jump(s) will fall back to the interpreter" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,160 @@
+#include "BatchRunner.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <utility>
+
+bool BatchRunner::loadJobs(const std::string& filename)
+{
+	std::ifstream jobFile{ filename };
+	if (!jobFile)
+	{
+		std::cout << "Failed to open " << filename << std::endl;
+		return false;
+	}
+
+	std::string line{};
+	int lineNumber{ 0 };
+	while (std::getline(jobFile, line))
+	{
+		++lineNumber;
+		if (line.empty() || line[0] == '#') continue;
+
+		BatchJob job{};
+		std::istringstream fields{ line };
+		if (!(fields >> job.rom >> job.input >> job.seed >> job.frames))
+		{
+			std::cout << filename << ':' << lineNumber << ": expected <rom> <input> <seed> <frames>" << std::endl;
+			return false;
+		}
+
+		if (!roms.count(job.rom) && !Headless::loadRom(job.rom, roms[job.rom])) return false;
+		if (job.input != "-" && !inputScripts.count(job.input) && !Headless::loadInputScript(job.input, inputScripts[job.input])) return false;
+
+		jobs.push_back(job);
+	}
+
+	results.assign(jobs.size(), BatchResult{});
+	return true;
+}
+
+void BatchRunner::run(WorkStealingPool& pool)
+{
+	pool.run(jobs.size(), [this](std::size_t index)
+	{
+		results[index] = runJob(jobs[index]);
+	});
+}
+
+void BatchRunner::runLockstep(WorkStealingPool& pool)
+{
+	// Fill groups in job file order, one open group per ROM and frame count
+	std::vector<std::vector<std::size_t>> groups{};
+	std::map<std::pair<std::string, std::uint32_t>, std::size_t> openGroups{};
+	for (std::size_t index{ 0 }; index < jobs.size(); ++index)
+	{
+		auto key{ std::make_pair(jobs[index].rom, jobs[index].frames) };
+		auto open{ openGroups.find(key) };
+		if (open == openGroups.end() || groups[open->second].size() == Chip8Simd::LANES)
+		{
+			openGroups[key] = groups.size();
+			groups.emplace_back();
+		}
+		groups[openGroups[key]].push_back(index);
+	}
+
+	pool.run(groups.size(), [this, &groups](std::size_t index)
+	{
+		runLockstepGroup(groups[index]);
+	});
+}
+
+BatchResult BatchRunner::runJob(const BatchJob& job) const
+{
+	auto start = std::chrono::steady_clock::now();
+
+	auto chip8{ std::make_unique<Chip8>() };
+	chip8->setPlatform(Chip8::platformForRom(job.rom));
+	chip8->loadRom(roms.at(job.rom));
+	chip8->seedRng(job.seed);
+
+	const input_script_type* script{ (job.input == "-") ? nullptr : &inputScripts.at(job.input) };
+	std::size_t nextEvent{ 0 };
+
+	for (std::uint32_t frame{ 0 }; frame < job.frames; ++frame)
+	{
+		Headless::pressKeys(script, nextEvent, frame, *chip8);
+		chip8->runFrame();
+	}
+
+	BatchResult result{};
+	result.framebufferHash = Headless::hashFramebuffer(chip8->getFramebuffer());
+	result.instructions = chip8->getInstructionCount();
+	result.wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+// The jobs in group share a ROM and frame count, each gets its own lane with its own seed and input script
+void BatchRunner::runLockstepGroup(const std::vector<std::size_t>& group)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	const BatchJob& first{ jobs[group.front()] };
+	auto prototype{ std::make_unique<Chip8>() };
+	prototype->setPlatform(Chip8::platformForRom(first.rom));
+	prototype->loadRom(roms.at(first.rom));
+
+	auto lanes{ std::make_unique<Chip8Simd>(*prototype, group.size()) };
+	std::vector<const input_script_type*> scripts(group.size(), nullptr);
+	for (std::size_t lane{ 0 }; lane < group.size(); ++lane)
+	{
+		const BatchJob& job{ jobs[group[lane]] };
+		lanes->seedRng(lane, job.seed);
+		if (job.input != "-") scripts[lane] = &inputScripts.at(job.input);
+	}
+
+	std::vector<std::size_t> nextEvent(group.size(), 0);
+	for (std::uint32_t frame{ 0 }; frame < first.frames; ++frame)
+	{
+		for (std::size_t lane{ 0 }; lane < group.size(); ++lane)
+		{
+			const input_script_type* script{ scripts[lane] };
+			while (script && nextEvent[lane] < script->size() && (*script)[nextEvent[lane]].frame <= frame)
+			{
+				lanes->setKeys(lane, (*script)[nextEvent[lane]].keys);
+				++nextEvent[lane];
+			}
+		}
+
+		lanes->runFrame();
+	}
+
+	// The group's time is shared out evenly, its lanes can't be timed apart
+	double wallMs{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / static_cast<double>(group.size()) };
+	for (std::size_t lane{ 0 }; lane < group.size(); ++lane)
+	{
+		BatchResult& result{ results[group[lane]] };
+		result.framebufferHash = Headless::hashFramebuffer(lanes->getFramebuffer(lane));
+		result.instructions = lanes->getInstructionCount(lane);
+		result.wallMs = wallMs;
+	}
+}
+
+void BatchRunner::writeResults(std::ostream& out) const
+{
+	out << "rom,input,seed,frames,framebuffer_hash,instructions,wall_ms\n";
+	for (std::size_t i{ 0 }; i < jobs.size(); ++i)
+	{
+		const BatchJob& job{ jobs[i] };
+		const BatchResult& result{ results[i] };
+
+		out << job.rom << ',' << job.input << ',' << job.seed << ',' << job.frames << ','
+			<< std::hex << std::setw(16) << std::setfill('0') << result.framebufferHash << std::dec << ','
+			<< result.instructions << ','
+			<< std::fixed << std::setprecision(3) << result.wallMs << '\n';
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Chip8.h"
+#include "Chip8Simd.h"
+#include "Headless.h"
+#include "WorkStealingPool.h"
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// One line of a job file, see README.md
+struct BatchJob
+{
+	std::string rom{};
+	std::string input{};		// Input script, or "-" for none
+	std::uint32_t seed{};
+	std::uint32_t frames{};
+};
+
+struct BatchResult
+{
+	std::uint64_t framebufferHash{};
+	std::uint64_t instructions{};
+	double wallMs{};
+};
+
+// Runs every job in a job file headlessly and records the final state of each
+class BatchRunner
+{
+public:
+	// Also loads every ROM and input script the jobs name, so workers never touch the disk
+	bool loadJobs(const std::string& filename);
+
+	void run(WorkStealingPool& pool);
+
+	// Same results, but jobs on the same ROM and frame count run in groups of Chip8Simd::LANES
+	void runLockstep(WorkStealingPool& pool);
+
+	void writeResults(std::ostream& out) const;
+
+	std::size_t jobCount() const
+	{
+		return jobs.size();
+	}
+
+private:
+	using input_script_type = Headless::input_script_type;
+
+	std::vector<BatchJob> jobs{};
+	std::vector<BatchResult> results{};		// Indexed like jobs, each written by one worker only
+
+	std::map<std::string, std::vector<std::uint8_t>> roms{};
+	std::map<std::string, input_script_type> inputScripts{};
+
+	BatchResult runJob(const BatchJob& job) const;
+	void runLockstepGroup(const std::vector<std::size_t>& group);
+};
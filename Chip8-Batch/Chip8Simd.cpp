@@ -0,0 +1,843 @@
+#include "Chip8Simd.h"
+
+#include <algorithm>
+
+// AVX2 needs the file built for it (-mavx2 or /arch:AVX2), SSE2 is part of the x86-64 baseline
+#if defined(__AVX2__)
+#define CHIP8_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CHIP8_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	constexpr std::size_t LANES{ Chip8Simd::LANES };
+	constexpr std::uint32_t ALL_LANES{ (1u << LANES) - 1 };
+
+	// One 32-bit value per lane. Every value stays below 2^31, so signed compares are safe
+#if defined(CHIP8_SIMD_AVX2)
+	struct Lanes
+	{
+		__m256i v;
+	};
+
+	inline Lanes load(const std::array<std::uint32_t, LANES>& values)
+	{
+		return { _mm256_load_si256(reinterpret_cast<const __m256i*>(values.data())) };
+	}
+
+	// Zero-extend one byte per lane
+	inline Lanes loadBytes(const std::array<std::uint8_t, LANES>& values)
+	{
+		return { _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(values.data()))) };
+	}
+
+	inline void store(std::array<std::uint32_t, LANES>& values, Lanes value)
+	{
+		_mm256_store_si256(reinterpret_cast<__m256i*>(values.data()), value.v);
+	}
+
+	inline Lanes splat(std::uint32_t value)
+	{
+		return { _mm256_set1_epi32(static_cast<int>(value)) };
+	}
+
+	inline Lanes operator+(Lanes a, Lanes b) { return { _mm256_add_epi32(a.v, b.v) }; }
+	inline Lanes operator-(Lanes a, Lanes b) { return { _mm256_sub_epi32(a.v, b.v) }; }
+	inline Lanes operator&(Lanes a, Lanes b) { return { _mm256_and_si256(a.v, b.v) }; }
+	inline Lanes operator|(Lanes a, Lanes b) { return { _mm256_or_si256(a.v, b.v) }; }
+	inline Lanes operator^(Lanes a, Lanes b) { return { _mm256_xor_si256(a.v, b.v) }; }
+	inline Lanes operator>>(Lanes a, int shift) { return { _mm256_srli_epi32(a.v, shift) }; }
+	inline Lanes operator<<(Lanes a, int shift) { return { _mm256_slli_epi32(a.v, shift) }; }
+	inline Lanes operator>>(Lanes a, Lanes shift) { return { _mm256_srlv_epi32(a.v, shift.v) }; }
+
+	// All ones in the lanes where the comparison holds
+	inline Lanes equal(Lanes a, Lanes b) { return { _mm256_cmpeq_epi32(a.v, b.v) }; }
+	inline Lanes greater(Lanes a, Lanes b) { return { _mm256_cmpgt_epi32(a.v, b.v) }; }
+
+	inline Lanes select(Lanes mask, Lanes ifSet, Lanes ifClear)
+	{
+		return { _mm256_blendv_epi8(ifClear.v, ifSet.v, mask.v) };
+	}
+
+	// Bit n set for each lane n of a comparison result
+	inline std::uint32_t bits(Lanes mask)
+	{
+		return static_cast<std::uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(mask.v)));
+	}
+
+	inline Lanes laneMask(std::uint32_t lanes)
+	{
+		const __m256i laneBits = _mm256_set_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+		const __m256i selected = _mm256_and_si256(_mm256_set1_epi32(static_cast<int>(lanes)), laneBits);
+		return { _mm256_cmpeq_epi32(selected, laneBits) };
+	}
+
+	inline std::uint32_t minimum(Lanes a)
+	{
+		__m256i folded = _mm256_min_epu32(a.v, _mm256_permute2x128_si256(a.v, a.v, 1));
+		folded = _mm256_min_epu32(folded, _mm256_shuffle_epi32(folded, 0x4E));
+		folded = _mm256_min_epu32(folded, _mm256_shuffle_epi32(folded, 0xB1));
+		return static_cast<std::uint32_t>(_mm256_cvtsi256_si32(folded));
+	}
+#elif defined(CHIP8_SIMD_SSE2)
+	// Two 128-bit halves, lanes 0-3 and 4-7
+	struct Lanes
+	{
+		__m128i low;
+		__m128i high;
+	};
+
+	inline Lanes load(const std::array<std::uint32_t, LANES>& values)
+	{
+		const __m128i* half{ reinterpret_cast<const __m128i*>(values.data()) };
+		return { _mm_load_si128(half), _mm_load_si128(half + 1) };
+	}
+
+	inline Lanes loadBytes(const std::array<std::uint8_t, LANES>& values)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(values.data())), zero);
+		return { _mm_unpacklo_epi16(words, zero), _mm_unpackhi_epi16(words, zero) };
+	}
+
+	inline void store(std::array<std::uint32_t, LANES>& values, Lanes value)
+	{
+		__m128i* half{ reinterpret_cast<__m128i*>(values.data()) };
+		_mm_store_si128(half, value.low);
+		_mm_store_si128(half + 1, value.high);
+	}
+
+	inline Lanes splat(std::uint32_t value)
+	{
+		const __m128i half = _mm_set1_epi32(static_cast<int>(value));
+		return { half, half };
+	}
+
+	inline Lanes operator+(Lanes a, Lanes b) { return { _mm_add_epi32(a.low, b.low), _mm_add_epi32(a.high, b.high) }; }
+	inline Lanes operator-(Lanes a, Lanes b) { return { _mm_sub_epi32(a.low, b.low), _mm_sub_epi32(a.high, b.high) }; }
+	inline Lanes operator&(Lanes a, Lanes b) { return { _mm_and_si128(a.low, b.low), _mm_and_si128(a.high, b.high) }; }
+	inline Lanes operator|(Lanes a, Lanes b) { return { _mm_or_si128(a.low, b.low), _mm_or_si128(a.high, b.high) }; }
+	inline Lanes operator^(Lanes a, Lanes b) { return { _mm_xor_si128(a.low, b.low), _mm_xor_si128(a.high, b.high) }; }
+	inline Lanes operator>>(Lanes a, int shift) { return { _mm_srli_epi32(a.low, shift), _mm_srli_epi32(a.high, shift) }; }
+	inline Lanes operator<<(Lanes a, int shift) { return { _mm_slli_epi32(a.low, shift), _mm_slli_epi32(a.high, shift) }; }
+
+	// SSE2 can only shift every lane by the same amount
+	inline Lanes operator>>(Lanes a, Lanes shift)
+	{
+		alignas(16) std::array<std::uint32_t, LANES> values{};
+		alignas(16) std::array<std::uint32_t, LANES> shifts{};
+		store(values, a);
+		store(shifts, shift);
+		for (std::size_t lane{ 0 }; lane < LANES; ++lane)
+		{
+			values[lane] = (shifts[lane] < 32) ? values[lane] >> shifts[lane] : 0;
+		}
+		return load(values);
+	}
+
+	inline Lanes equal(Lanes a, Lanes b) { return { _mm_cmpeq_epi32(a.low, b.low), _mm_cmpeq_epi32(a.high, b.high) }; }
+	inline Lanes greater(Lanes a, Lanes b) { return { _mm_cmpgt_epi32(a.low, b.low), _mm_cmpgt_epi32(a.high, b.high) }; }
+
+	inline Lanes select(Lanes mask, Lanes ifSet, Lanes ifClear)
+	{
+		return { _mm_or_si128(_mm_and_si128(mask.low, ifSet.low), _mm_andnot_si128(mask.low, ifClear.low)),
+			_mm_or_si128(_mm_and_si128(mask.high, ifSet.high), _mm_andnot_si128(mask.high, ifClear.high)) };
+	}
+
+	inline std::uint32_t bits(Lanes mask)
+	{
+		std::uint32_t low{ static_cast<std::uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(mask.low))) };
+		std::uint32_t high{ static_cast<std::uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(mask.high))) };
+		return low | (high << 4);
+	}
+
+	inline Lanes laneMask(std::uint32_t lanes)
+	{
+		const __m128i selected = _mm_set1_epi32(static_cast<int>(lanes));
+		const __m128i lowBits = _mm_set_epi32(0x08, 0x04, 0x02, 0x01);
+		const __m128i highBits = _mm_set_epi32(0x80, 0x40, 0x20, 0x10);
+		return { _mm_cmpeq_epi32(_mm_and_si128(selected, lowBits), lowBits), _mm_cmpeq_epi32(_mm_and_si128(selected, highBits), highBits) };
+	}
+
+	// SSE2 has no unsigned 32-bit minimum, and this only runs after lanes diverge
+	inline std::uint32_t minimum(Lanes a)
+	{
+		alignas(16) std::array<std::uint32_t, LANES> values{};
+		store(values, a);
+		return *std::min_element(values.begin(), values.end());
+	}
+#else
+	struct Lanes
+	{
+		std::array<std::uint32_t, LANES> v;
+	};
+
+	template<typename Function>
+	inline Lanes map(Function function)
+	{
+		Lanes result{};
+		for (std::size_t lane{ 0 }; lane < LANES; ++lane)
+		{
+			result.v[lane] = function(lane);
+		}
+		return result;
+	}
+
+	inline Lanes load(const std::array<std::uint32_t, LANES>& values) { return { values }; }
+	inline Lanes loadBytes(const std::array<std::uint8_t, LANES>& values) { return map([&](std::size_t i) { return std::uint32_t{ values[i] }; }); }
+	inline void store(std::array<std::uint32_t, LANES>& values, Lanes value) { values = value.v; }
+	inline Lanes splat(std::uint32_t value) { return map([=](std::size_t) { return value; }); }
+
+	inline Lanes operator+(Lanes a, Lanes b) { return map([&](std::size_t i) { return a.v[i] + b.v[i]; }); }
+	inline Lanes operator-(Lanes a, Lanes b) { return map([&](std::size_t i) { return a.v[i] - b.v[i]; }); }
+	inline Lanes operator&(Lanes a, Lanes b) { return map([&](std::size_t i) { return a.v[i] & b.v[i]; }); }
+	inline Lanes operator|(Lanes a, Lanes b) { return map([&](std::size_t i) { return a.v[i] | b.v[i]; }); }
+	inline Lanes operator^(Lanes a, Lanes b) { return map([&](std::size_t i) { return a.v[i] ^ b.v[i]; }); }
+	inline Lanes operator>>(Lanes a, int shift) { return map([&](std::size_t i) { return a.v[i] >> shift; }); }
+	inline Lanes operator<<(Lanes a, int shift) { return map([&](std::size_t i) { return a.v[i] << shift; }); }
+	inline Lanes operator>>(Lanes a, Lanes shift) { return map([&](std::size_t i) { return (shift.v[i] < 32) ? a.v[i] >> shift.v[i] : 0; }); }
+
+	inline Lanes equal(Lanes a, Lanes b) { return map([&](std::size_t i) { return (a.v[i] == b.v[i]) ? 0xFFFFFFFF : 0; }); }
+	inline Lanes greater(Lanes a, Lanes b) { return map([&](std::size_t i) { return (a.v[i] > b.v[i]) ? 0xFFFFFFFF : 0; }); }
+
+	inline Lanes select(Lanes mask, Lanes ifSet, Lanes ifClear)
+	{
+		return map([&](std::size_t i) { return mask.v[i] ? ifSet.v[i] : ifClear.v[i]; });
+	}
+
+	inline std::uint32_t bits(Lanes mask)
+	{
+		std::uint32_t result{ 0 };
+		for (std::size_t lane{ 0 }; lane < LANES; ++lane)
+		{
+			result |= (mask.v[lane] & 1) << lane;
+		}
+		return result;
+	}
+
+	inline Lanes laneMask(std::uint32_t lanes)
+	{
+		return map([=](std::size_t i) { return ((lanes >> i) & 1) ? 0xFFFFFFFF : 0; });
+	}
+
+	inline std::uint32_t minimum(Lanes a)
+	{
+		return *std::min_element(a.v.begin(), a.v.end());
+	}
+#endif
+
+	// Write value to the masked lanes of a field, leaving the others alone
+	inline void storeMasked(std::array<std::uint32_t, LANES>& values, Lanes value, Lanes mask)
+	{
+		store(values, select(mask, value, load(values)));
+	}
+
+	inline int lowestLane(std::uint32_t lanes)
+	{
+		int lane{ 0 };
+		while (!((lanes >> lane) & 1)) ++lane;
+		return lane;
+	}
+
+	// Call function(lane) for each lane set in lanes, for the instructions that touch memory a lane at a time
+	template<typename Function>
+	inline void forEachLane(std::uint32_t lanes, Function function)
+	{
+		for (std::size_t lane{ 0 }; lanes != 0; ++lane, lanes >>= 1)
+		{
+			if (lanes & 1) function(lane);
+		}
+	}
+
+	// Chip8 would index past the end of memory here, each lane wraps around instead
+	inline std::size_t wrap(std::uint32_t address)
+	{
+		return address & (Chip8::MEMORY_SIZE - 1);
+	}
+}
+
+Chip8Simd::Chip8Simd(const Chip8& prototype, std::size_t instances)
+	: instanceCount{ instances },
+	groups((instances + LANES - 1) / LANES),
+	platform{ prototype.getPlatform() },
+	jumpOffsetUsesX{ prototype.profile->jumpOffsetUsesX },
+	shiftUsesY{ prototype.profile->shiftUsesY },
+	loadStoreIncrementsIr{ prototype.profile->loadStoreIncrementsIr },
+	instructionsPerFrame{ prototype.instructionsPerFrame }
+{
+	std::uint16_t keys{ 0 };
+	for (int key{ 0 }; key < Chip8::KEY_COUNT; ++key)
+	{
+		if (prototype.keypad[key]) keys |= static_cast<std::uint16_t>(1 << key);
+	}
+
+	for (std::size_t instance{ 0 }; instance < instances; ++instance)
+	{
+		Group& group{ groups[instance / LANES] };
+		std::size_t lane{ instance % LANES };
+
+		for (std::size_t reg{ 0 }; reg < 16; ++reg)
+		{
+			group.registers[reg][lane] = prototype.registers[reg];
+		}
+		group.pc[lane] = prototype.pc;
+		group.ir[lane] = prototype.ir;
+		group.delayTimer[lane] = prototype.delayTimer;
+		group.soundTimer[lane] = prototype.soundTimer;
+		group.frameInstructions[lane] = prototype.frameInstructions;
+		group.keys[lane] = keys;
+
+		for (std::size_t address{ 0 }; address < Chip8::MEMORY_SIZE; ++address)
+		{
+			group.memory[address][lane] = prototype.memory[address];
+		}
+		for (int row{ 0 }; row < Chip8::DISPLAY_HEIGHT; ++row)
+		{
+			group.display[row][lane] = prototype.display[row];
+		}
+
+		group.rng[lane] = prototype.rng;
+		group.instructionCount[lane] = prototype.instructionCount;
+
+		for (std::size_t entry{ 0 }; entry < Chip8::STACK_SIZE; ++entry)
+		{
+			group.stack[entry][lane] = prototype.stack[entry];
+		}
+		group.sp[lane] = prototype.sp;
+		group.stackFaulted |= static_cast<std::uint32_t>(prototype.stackFaulted) << lane;
+	}
+
+	// Lanes past the last instance never run
+	if (instances % LANES != 0)
+	{
+		groups.back().faulted |= ALL_LANES & ~((1u << (instances % LANES)) - 1);
+	}
+}
+
+Chip8Simd::Kernel Chip8Simd::kernel()
+{
+#if defined(CHIP8_SIMD_AVX2)
+	return Kernel::Avx2;
+#elif defined(CHIP8_SIMD_SSE2)
+	return Kernel::Sse2;
+#else
+	return Kernel::Scalar;
+#endif
+}
+
+void Chip8Simd::seedRng(std::size_t instance, std::uint32_t seed, std::uint32_t stream)
+{
+	groups[instance / LANES].rng[instance % LANES].seed(seed, stream);
+}
+
+void Chip8Simd::setKeys(std::size_t instance, std::uint16_t keys)
+{
+	groups[instance / LANES].keys[instance % LANES] = keys;
+}
+
+void Chip8Simd::run(std::size_t instructions)
+{
+	for (Group& group : groups)
+	{
+		for (std::size_t lane{ 0 }; lane < LANES; ++lane)
+		{
+			bool running{ !((group.faulted >> lane) & 1) };
+			group.budget[lane] = running ? static_cast<std::uint32_t>(instructions) : 0;
+			group.instructionCount[lane] += group.budget[lane];
+		}
+		runGroup(group);
+	}
+}
+
+void Chip8Simd::runFrame()
+{
+	for (Group& group : groups)
+	{
+		for (std::size_t lane{ 0 }; lane < LANES; ++lane)
+		{
+			bool running{ !((group.faulted >> lane) & 1) };
+			group.budget[lane] = running ? instructionsPerFrame - group.frameInstructions[lane] : 0;
+			group.instructionCount[lane] += group.budget[lane];
+		}
+		runGroup(group);
+	}
+}
+
+// Chip8::decodeInstruction(), visible here so it can be inlined into the step loop
+Chip8::Instruction Chip8Simd::decode(std::uint16_t opcode)
+{
+	Chip8::Instruction inst{};
+	inst.opcode = opcode;
+	inst.nnn = opcode & Chip8::BITMASK_NNN;
+	inst.nn = static_cast<std::uint8_t>(opcode & Chip8::BITMASK_NN);
+	inst.n = static_cast<std::uint8_t>(opcode & Chip8::BITMASK_N);
+	inst.x = static_cast<std::uint8_t>((opcode & Chip8::BITMASK_X) >> 8);
+	inst.y = static_cast<std::uint8_t>((opcode & Chip8::BITMASK_Y) >> 4);
+	inst.op = Chip8::decodeTable[opcode];
+	return inst;
+}
+
+// Each step runs the instruction at the lowest pc for every lane that is there and holds the same opcode.
+// Lanes ahead of it wait, so a lane that took a branch is caught up with at the next jump back or common exit.
+// While every lane is running together the next pc is already known, and finding the lowest one is skipped.
+void Chip8Simd::runGroup(Group& group)
+{
+	const Lanes zero{ splat(0) };
+	const Lanes one{ splat(1) };
+	const Lanes two{ splat(2) };
+	const Lanes unused{ splat(0xFFFFFFFF) };
+	const Lanes framePeriod{ splat(instructionsPerFrame) };
+
+	std::uint32_t leaderPc{ DIVERGED };
+	while (true)
+	{
+		Lanes active{ equal(load(group.budget), zero) ^ unused };
+		std::uint32_t activeLanes{ bits(active) };
+		if (activeLanes == 0) return;
+
+		Lanes pc{ load(group.pc) };
+		std::uint32_t atLeader{ activeLanes };
+		if (leaderPc == DIVERGED)
+		{
+			leaderPc = minimum(select(active, pc, unused));
+			atLeader &= bits(equal(pc, splat(leaderPc)));
+		}
+
+		if (leaderPc > Chip8::MEMORY_SIZE - 2)
+		{
+			fault(group, atLeader);
+			leaderPc = DIVERGED;
+			continue;
+		}
+
+		int leader{ lowestLane(atLeader) };
+		std::uint8_t high{ group.memory[leaderPc][leader] };
+		std::uint8_t low{ group.memory[leaderPc + 1][leader] };
+
+		// Lanes whose own code at pc was overwritten with something else wait for a step of their own
+		Lanes sameOpcode{ equal(loadBytes(group.memory[leaderPc]), splat(high)) & equal(loadBytes(group.memory[leaderPc + 1]), splat(low)) };
+		std::uint32_t lanes{ atLeader & bits(sameOpcode) };
+		Lanes mask{ laneMask(lanes) };
+
+		storeMasked(group.budget, load(group.budget) - one, mask);
+		storeMasked(group.pc, pc + two, mask);
+
+		// Same as Chip8::tickTimers(1) in each lane
+		Lanes frameInstructions{ load(group.frameInstructions) + one };
+		Lanes tick{ equal(frameInstructions, framePeriod) & mask };
+		storeMasked(group.frameInstructions, select(tick, zero, frameInstructions), mask);
+		Lanes delayTimer{ load(group.delayTimer) };
+		store(group.delayTimer, delayTimer - (tick & (equal(delayTimer, zero) ^ unused) & one));
+		Lanes soundTimer{ load(group.soundTimer) };
+		store(group.soundTimer, soundTimer - (tick & (equal(soundTimer, zero) ^ unused) & one));
+
+		std::uint32_t nextPc{ execute(group, decode(static_cast<std::uint16_t>((high << 8) | low)), lanes, leaderPc + 2) };
+
+		// Any lane left behind means the lowest pc has to be found again
+		leaderPc = (lanes == activeLanes) ? nextPc : DIVERGED;
+	}
+}
+
+// Where every lane in lanes is now, or DIVERGED
+std::uint32_t Chip8Simd::commonPc(const Group& group, std::uint32_t lanes)
+{
+	if (lanes == 0) return DIVERGED;
+
+	std::uint32_t pc{ group.pc[lowestLane(lanes)] };
+	bool together{ (bits(equal(load(group.pc), splat(pc))) & lanes) == lanes };
+	return together ? pc : DIVERGED;
+}
+
+// Mirrors the Chip8::opcode_* handlers, for the lanes set in lanes.
+// nextPc is where they all are now, the return value is where they all are afterwards, or DIVERGED.
+std::uint32_t Chip8Simd::execute(Group& group, const Chip8::Instruction& inst, std::uint32_t lanes, std::uint32_t nextPc)
+{
+	const Lanes mask{ laneMask(lanes) };
+	const Lanes zero{ splat(0) };
+	const Lanes byte{ splat(0xFF) };
+	const Lanes two{ splat(2) };
+
+	std::array<std::uint32_t, LANES>& regX{ group.registers[inst.x] };
+	std::array<std::uint32_t, LANES>& regY{ group.registers[inst.y] };
+	std::array<std::uint32_t, LANES>& regF{ group.registers[0xF] };
+
+	// Skip the next instruction in the lanes where condition is set
+	auto skipIf = [&](Lanes condition)
+	{
+		Lanes pc{ load(group.pc) };
+		store(group.pc, select(condition & mask, pc + two, pc));
+
+		std::uint32_t skipped{ bits(condition) & lanes };
+		if (skipped == 0) return nextPc;
+		return (skipped == lanes) ? nextPc + 2 : DIVERGED;
+	};
+
+	switch (inst.op)
+	{
+	case Chip8::Op::NOP:
+		break;
+
+	case Chip8::Op::OP_00E0:
+		forEachLane(lanes, [&](std::size_t lane)
+		{
+			for (auto& row : group.display) row[lane] = 0;
+		});
+		break;
+
+	case Chip8::Op::OP_00EE:
+		forEachLane(lanes, [&](std::size_t lane)
+		{
+			if (group.sp[lane] == 0)
+			{
+				faultStack(group, lane);
+				group.pc[lane] -= 2;
+				return;
+			}
+			group.pc[lane] = group.stack[--group.sp[lane]][lane];
+		});
+		return commonPc(group, lanes);
+
+	case Chip8::Op::OP_1NNN:
+		storeMasked(group.pc, splat(inst.nnn), mask);
+		skipIdleLoop(group, inst, lanes, nextPc - 2);
+		return inst.nnn;
+
+	case Chip8::Op::OP_2NNN:
+		forEachLane(lanes, [&](std::size_t lane)
+		{
+			if (group.sp[lane] == Chip8::STACK_SIZE)
+			{
+				faultStack(group, lane);
+				for (std::size_t entry{ 1 }; entry < Chip8::STACK_SIZE; ++entry)
+				{
+					group.stack[entry - 1][lane] = group.stack[entry][lane];
+				}
+				--group.sp[lane];
+			}
+			group.stack[group.sp[lane]++][lane] = static_cast<std::uint16_t>(group.pc[lane]);
+			group.pc[lane] = inst.nnn;
+		});
+		return inst.nnn;
+
+	case Chip8::Op::OP_3XNN:
+		return skipIf(equal(load(regX), splat(inst.nn)));
+
+	case Chip8::Op::OP_4XNN:
+		return skipIf(equal(load(regX), splat(inst.nn)) ^ splat(0xFFFFFFFF));
+
+	case Chip8::Op::OP_5XY0:
+		return skipIf(equal(load(regX), load(regY)));
+
+	case Chip8::Op::OP_6XNN:
+		storeMasked(regX, splat(inst.nn), mask);
+		break;
+
+	case Chip8::Op::OP_7XNN:
+		storeMasked(regX, (load(regX) + splat(inst.nn)) & byte, mask);
+		break;
+
+	case Chip8::Op::OP_8XY0:
+		storeMasked(regX, load(regY), mask);
+		break;
+
+	case Chip8::Op::OP_8XY1:
+		storeMasked(regX, load(regX) | load(regY), mask);
+		break;
+
+	case Chip8::Op::OP_8XY2:
+		storeMasked(regX, load(regX) & load(regY), mask);
+		break;
+
+	case Chip8::Op::OP_8XY3:
+		storeMasked(regX, load(regX) ^ load(regY), mask);
+		break;
+
+	// VF is written between reading and writing the other registers, exactly as the handlers do, in case X or Y is F
+	case Chip8::Op::OP_8XY4:
+	{
+		Lanes result{ load(regX) + load(regY) };
+		storeMasked(regF, result >> 8, mask);
+		storeMasked(regX, result & byte, mask);
+		break;
+	}
+
+	case Chip8::Op::OP_8XY5:
+		storeMasked(regF, greater(load(regX), load(regY)) >> 31, mask);
+		storeMasked(regX, (load(regX) - load(regY)) & byte, mask);
+		break;
+
+	case Chip8::Op::OP_8XY6:
+		if (shiftUsesY) storeMasked(regX, load(regY), mask);
+		storeMasked(regF, load(regX) & splat(1), mask);
+		storeMasked(regX, load(regX) >> 1, mask);
+		break;
+
+	case Chip8::Op::OP_8XY7:
+		storeMasked(regF, greater(load(regY), load(regX)) >> 31, mask);
+		storeMasked(regX, (load(regY) - load(regX)) & byte, mask);
+		break;
+
+	case Chip8::Op::OP_8XYE:
+		if (shiftUsesY) storeMasked(regX, load(regY), mask);
+		storeMasked(regF, load(regX) >> 7, mask);
+		storeMasked(regX, (load(regX) << 1) & byte, mask);
+		break;
+
+	case Chip8::Op::OP_9XY0:
+		return skipIf(equal(load(regX), load(regY)) ^ splat(0xFFFFFFFF));
+
+	case Chip8::Op::OP_ANNN:
+		storeMasked(group.ir, splat(inst.nnn), mask);
+		break;
+
+	case Chip8::Op::OP_BNNN:
+		storeMasked(group.pc, splat(inst.nnn) + load(jumpOffsetUsesX ? regX : group.registers[0]), mask);
+		return commonPc(group, lanes);
+
+	case Chip8::Op::OP_CXNN:
+		forEachLane(lanes, [&](std::size_t lane)
+		{
+			regX[lane] = static_cast<std::uint32_t>(inst.nn & group.rng[lane].nextByte());
+		});
+		break;
+
+	case Chip8::Op::OP_DXYN:
+		forEachLane(lanes, [&](std::size_t lane)
+		{
+			int xCoord{ static_cast<int>(regX[lane] % Chip8::DISPLAY_WIDTH) };
+			int yCoord{ static_cast<int>(regY[lane] % Chip8::DISPLAY_HEIGHT) };
+			std::uint32_t ir{ group.ir[lane] };
+
+			regF[lane] = 0;
+			for (int row{ 0 }; row < inst.n; ++row)
+			{
+				if (yCoord + row >= Chip8::DISPLAY_HEIGHT) break;
+
+				std::uint64_t spriteRow{ (static_cast<std::uint64_t>(group.memory[wrap(ir + row)][lane]) << 56) >> xCoord };
+				std::uint64_t& displayRow{ group.display[yCoord + row][lane] };
+				if (displayRow & spriteRow)
+				{
+					regF[lane] = 1;
+				}
+				displayRow ^= spriteRow;
+			}
+		});
+		break;
+
+	case Chip8::Op::OP_EX9E:
+		return skipIf(equal((load(group.keys) >> load(regX)) & splat(1), zero) ^ splat(0xFFFFFFFF));
+
+	case Chip8::Op::OP_EXA1:
+		return skipIf(equal((load(group.keys) >> load(regX)) & splat(1), zero));
+
+	case Chip8::Op::OP_FX07:
+		storeMasked(regX, load(group.delayTimer), mask);
+		break;
+
+	case Chip8::Op::OP_FX0A:
+		forEachLane(lanes, [&](std::size_t lane)
+		{
+			// Keys only change between calls, so the lane would run this again for the rest of its budget
+			if (group.keys[lane] == 0)
+			{
+				group.pc[lane] -= 2;
+				tickTimers(group, lane, group.budget[lane]);
+				group.budget[lane] = 0;
+			}
+			else
+			{
+				regX[lane] = static_cast<std::uint32_t>(lowestLane(group.keys[lane]));
+			}
+		});
+		return commonPc(group, lanes);
+
+	case Chip8::Op::OP_FX15:
+		storeMasked(group.delayTimer, load(regX), mask);
+		break;
+
+	case Chip8::Op::OP_FX18:
+		storeMasked(group.soundTimer, load(regX), mask);
+		break;
+
+	case Chip8::Op::OP_FX1E:
+	{
+		Lanes result{ load(group.ir) + load(regX) };
+		storeMasked(regF, greater(result, splat(0xFFF)) >> 31, mask);
+		storeMasked(group.ir, result & splat(0xFFFF), mask);
+		break;
+	}
+
+	case Chip8::Op::OP_FX29:
+	{
+		Lanes fontChar{ load(regX) };
+		storeMasked(group.ir, splat(Chip8::FONTCHAR_START) + (fontChar << 2) + fontChar, mask);
+		break;
+	}
+
+	case Chip8::Op::OP_FX33:
+		forEachLane(lanes, [&](std::size_t lane)
+		{
+			std::uint32_t number{ regX[lane] };
+			std::uint32_t ir{ group.ir[lane] };
+			group.memory[wrap(ir + 2)][lane] = static_cast<std::uint8_t>(number % 10);
+			group.memory[wrap(ir + 1)][lane] = static_cast<std::uint8_t>((number / 10) % 10);
+			group.memory[wrap(ir)][lane] = static_cast<std::uint8_t>(number / 100);
+		});
+		break;
+
+	case Chip8::Op::OP_FX55:
+		forEachLane(lanes, [&](std::size_t lane)
+		{
+			std::uint32_t ir{ group.ir[lane] };
+			for (int i{ 0 }; i <= inst.x; ++i)
+			{
+				group.memory[wrap(ir + i)][lane] = static_cast<std::uint8_t>(group.registers[i][lane]);
+			}
+			if (loadStoreIncrementsIr) group.ir[lane] = (ir + inst.x + 1) & 0xFFFF;
+		});
+		break;
+
+	case Chip8::Op::OP_FX65:
+		forEachLane(lanes, [&](std::size_t lane)
+		{
+			std::uint32_t ir{ group.ir[lane] };
+			for (int i{ 0 }; i <= inst.x; ++i)
+			{
+				group.registers[i][lane] = group.memory[wrap(ir + i)][lane];
+			}
+			if (loadStoreIncrementsIr) group.ir[lane] = (ir + inst.x + 1) & 0xFFFF;
+		});
+		break;
+
+	case Chip8::Op::COUNT:
+		break;
+	}
+
+	return nextPc;
+}
+
+// Chip8::run() fast-forwards a jump to itself, or back to an FX07/3X00 pair polling the delay timer, and so does each lane
+void Chip8Simd::skipIdleLoop(Group& group, const Chip8::Instruction& jump, std::uint32_t lanes, std::uint32_t jumpAddress) const
+{
+	if (jump.nnn == jumpAddress)
+	{
+		forEachLane(lanes, [&](std::size_t lane)
+		{
+			tickTimers(group, lane, group.budget[lane]);
+			group.budget[lane] = 0;
+		});
+		return;
+	}
+
+	if (jump.nnn + 4u != jumpAddress) return;
+
+	forEachLane(lanes, [&](std::size_t lane)
+	{
+		std::uint16_t poll{ static_cast<std::uint16_t>((group.memory[jump.nnn][lane] << 8) | group.memory[jump.nnn + 1][lane]) };
+		std::uint16_t test{ static_cast<std::uint16_t>((group.memory[jump.nnn + 2][lane] << 8) | group.memory[jump.nnn + 3][lane]) };
+		if ((poll & 0xF0FF) != 0xF007 || test != (0x3000 | (poll & Chip8::BITMASK_X))) return;
+
+		std::uint32_t value{ group.registers[(poll & Chip8::BITMASK_X) >> 8][lane] };
+		if (group.delayTimer[lane] == 0 || value != group.delayTimer[lane]) return;
+
+		std::uint32_t untilTick{ instructionsPerFrame - group.frameInstructions[lane] - 1 };
+		std::uint32_t skipped{ std::min((untilTick + 2) / 3, group.budget[lane] / 3) * 3 };
+		tickTimers(group, lane, skipped);
+		group.budget[lane] -= skipped;
+	});
+}
+
+// Chip8::tickTimers() for one lane
+void Chip8Simd::tickTimers(Group& group, std::size_t lane, std::uint32_t instructions) const
+{
+	std::uint32_t elapsed{ group.frameInstructions[lane] + instructions };
+	std::uint32_t ticks{ elapsed / instructionsPerFrame };
+	group.frameInstructions[lane] = elapsed % instructionsPerFrame;
+
+	group.delayTimer[lane] = (group.delayTimer[lane] > ticks) ? group.delayTimer[lane] - ticks : 0;
+	group.soundTimer[lane] = (group.soundTimer[lane] > ticks) ? group.soundTimer[lane] - ticks : 0;
+}
+
+// Stop the given lanes, they no longer count the instructions they had left
+void Chip8Simd::fault(Group& group, std::uint32_t lanes)
+{
+	forEachLane(lanes, [&](std::size_t lane)
+	{
+		group.instructionCount[lane] -= group.budget[lane];
+		group.budget[lane] = 0;
+	});
+	group.faulted |= lanes;
+}
+
+// A lane's 2NNN/00EE found the stack full or empty, handled as Chip8 does but without the report
+void Chip8Simd::faultStack(Group& group, std::size_t lane)
+{
+	group.stackFaulted |= 1u << lane;
+}
+
+bool Chip8Simd::isFaulted(std::size_t instance) const
+{
+	return (groups[instance / LANES].faulted >> (instance % LANES)) & 1;
+}
+
+std::uint64_t Chip8Simd::getInstructionCount(std::size_t instance) const
+{
+	return groups[instance / LANES].instructionCount[instance % LANES];
+}
+
+Chip8::framebuffer_type Chip8Simd::getFramebuffer(std::size_t instance) const
+{
+	const Group& group{ groups[instance / LANES] };
+	std::size_t lane{ instance % LANES };
+
+	Chip8::framebuffer_type framebuffer{};
+	for (int row{ 0 }; row < Chip8::DISPLAY_HEIGHT; ++row)
+	{
+		framebuffer[row] = group.display[row][lane];
+	}
+	return framebuffer;
+}
+
+void Chip8Simd::copyTo(std::size_t instance, Chip8& chip8) const
+{
+	const Group& group{ groups[instance / LANES] };
+	std::size_t lane{ instance % LANES };
+
+	for (std::size_t reg{ 0 }; reg < 16; ++reg)
+	{
+		chip8.registers[reg] = static_cast<std::uint8_t>(group.registers[reg][lane]);
+	}
+	chip8.pc = static_cast<std::uint16_t>(group.pc[lane]);
+	chip8.ir = static_cast<std::uint16_t>(group.ir[lane]);
+	chip8.delayTimer = static_cast<std::uint8_t>(group.delayTimer[lane]);
+	chip8.soundTimer = static_cast<std::uint8_t>(group.soundTimer[lane]);
+	chip8.setPlatform(platform);
+	chip8.instructionsPerFrame = instructionsPerFrame;
+	chip8.frameInstructions = group.frameInstructions[lane];
+	chip8.instructionCount = group.instructionCount[lane];
+
+	for (std::size_t entry{ 0 }; entry < Chip8::STACK_SIZE; ++entry)
+	{
+		chip8.stack[entry] = group.stack[entry][lane];
+	}
+	chip8.sp = static_cast<std::uint8_t>(group.sp[lane]);
+	chip8.stackFaulted = (group.stackFaulted >> lane) & 1;
+
+	for (std::size_t address{ 0 }; address < Chip8::MEMORY_SIZE; ++address)
+	{
+		chip8.memory[address] = group.memory[address][lane];
+	}
+	chip8.invalidateDecoded(0, Chip8::MEMORY_SIZE);
+
+	for (int key{ 0 }; key < Chip8::KEY_COUNT; ++key)
+	{
+		chip8.keypad[key] = (group.keys[lane] >> key) & 1;
+	}
+
+	chip8.display = getFramebuffer(instance);
+	chip8.dirtyRows = Chip8::ALL_ROWS_DIRTY;
+	chip8.rng = group.rng[lane];
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Chip8.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Runs many copies of one Chip8 in lockstep, LANES at a time.
+// Every piece of state is stored structure-of-arrays, one slot per lane, so an instruction decoded once is executed for
+// every lane at its pc with one vector operation.
+// Lanes that branch elsewhere are masked off, and the lowest pc always runs next so they catch each other up again.
+// Each lane follows exactly what Chip8::cycle() would, including the virtual clock and the platform's quirks.
+class Chip8Simd
+{
+public:
+	static constexpr std::size_t LANES{ 8 };		// 32-bit values per 256-bit register
+
+	enum class Kernel
+	{
+		Scalar,	// A loop over the lanes
+		Sse2,	// Two 128-bit halves
+		Avx2	// One 256-bit register, when Chip8Simd.cpp is built with AVX2 enabled
+	};
+
+	// Every instance starts as a copy of prototype, usually one with a ROM just loaded
+	Chip8Simd(const Chip8& prototype, std::size_t instances);
+
+	// Chosen when Chip8Simd.cpp is compiled
+	static Kernel kernel();
+
+	std::size_t size() const
+	{
+		return instanceCount;
+	}
+
+	void seedRng(std::size_t instance, std::uint32_t seed, std::uint32_t stream = 0);
+
+	// Bit n is set while key n is held
+	void setKeys(std::size_t instance, std::uint16_t keys);
+
+	// Run every instance for the given number of instructions
+	void run(std::size_t instructions);
+
+	// Run every instance up to its next 60Hz timer tick, like Chip8::runFrame() without a display wait
+	void runFrame();
+
+	// Ran past the end of memory, where Chip8 would read out of bounds, and has stopped
+	bool isFaulted(std::size_t instance) const;
+
+	std::uint64_t getInstructionCount(std::size_t instance) const;
+	Chip8::framebuffer_type getFramebuffer(std::size_t instance) const;
+
+	// Copy an instance's whole state into chip8, to render it or carry on with it alone
+	void copyTo(std::size_t instance, Chip8& chip8) const;
+
+private:
+	using lane_type = std::array<std::uint32_t, LANES>;
+
+	// State of LANES instances, indexed [field][lane] so each field's lanes fill one vector
+	struct Group
+	{
+		alignas(32) std::array<lane_type, 16> registers{};
+		alignas(32) lane_type pc{};
+		alignas(32) lane_type ir{};
+		alignas(32) lane_type sp{};					// Next free stack entry
+		alignas(32) lane_type delayTimer{};
+		alignas(32) lane_type soundTimer{};
+		alignas(32) lane_type frameInstructions{};	// Instructions since the timers last ticked
+		alignas(32) lane_type keys{};
+		alignas(32) lane_type budget{};				// Instructions left to run in this call
+
+		std::array<std::array<std::uint16_t, LANES>, Chip8::STACK_SIZE> stack{};
+		std::array<std::array<std::uint8_t, LANES>, Chip8::MEMORY_SIZE> memory{};
+		std::array<std::array<std::uint64_t, LANES>, Chip8::DISPLAY_HEIGHT> display{};
+
+		std::array<Chip8::Rng, LANES> rng{};
+		std::array<std::uint64_t, LANES> instructionCount{};
+		std::uint32_t faulted{};		// Bit n is set once lane n has stopped
+		std::uint32_t stackFaulted{};	// Bit n is set once lane n has overflowed or underflowed its stack
+	};
+
+	std::size_t instanceCount{};
+	std::vector<Group> groups{};
+
+	// The prototype's platform, with its quirks copied out for execute()
+	Chip8::Platform platform{};
+	bool jumpOffsetUsesX{};
+	bool shiftUsesY{};
+	bool loadStoreIncrementsIr{};
+	std::uint32_t instructionsPerFrame{};
+
+	static constexpr std::uint32_t DIVERGED{ 0xFFFFFFFF };	// Not every lane is at the same pc
+
+	static Chip8::Instruction decode(std::uint16_t opcode);
+	void runGroup(Group& group);
+	std::uint32_t execute(Group& group, const Chip8::Instruction& inst, std::uint32_t lanes, std::uint32_t nextPc);
+	static std::uint32_t commonPc(const Group& group, std::uint32_t lanes);
+	void skipIdleLoop(Group& group, const Chip8::Instruction& jump, std::uint32_t lanes, std::uint32_t jumpAddress) const;
+	void tickTimers(Group& group, std::size_t lane, std::uint32_t instructions) const;
+	static void fault(Group& group, std::uint32_t lanes);
+	static void faultStack(Group& group, std::size_t lane);
+};
@@ -0,0 +1,57 @@
+#include "BatchRunner.h"
+#include "WorkStealingPool.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+int main(int argc, char* argv[])
+{
+	bool lockstep{ argc > 1 && std::string{ argv[1] } == "--lockstep" };
+	if (lockstep)
+	{
+		--argc;
+		++argv;
+	}
+
+	if (argc < 3)
+	{
+		std::cout << "Usage: Chip8-Batch [--lockstep] <jobs> <results.csv> [threads]" << std::endl;
+		return 1;
+	}
+
+	std::string jobsPath{ argv[1] };
+	std::string resultsPath{ argv[2] };
+	unsigned threads{ (argc > 3) ? static_cast<unsigned>(std::stoul(argv[3])) : std::thread::hardware_concurrency() };
+
+	BatchRunner runner{};
+	if (!runner.loadJobs(jobsPath)) return 1;
+
+	std::ofstream results{ resultsPath };
+	if (!results)
+	{
+		std::cout << "Failed to open " << resultsPath << std::endl;
+		return 1;
+	}
+
+	WorkStealingPool pool{ threads };
+
+	auto start = std::chrono::steady_clock::now();
+	if (lockstep)
+	{
+		runner.runLockstep(pool);
+	}
+	else
+	{
+		runner.run(pool);
+	}
+	double elapsedMs{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() };
+
+	runner.writeResults(results);
+
+	std::cout << "Ran " << runner.jobCount() << " jobs on " << pool.threads() << " threads in " << elapsedMs << "ms ("
+		<< pool.steals() << " stolen)" << std::endl;
+	return 0;
+}
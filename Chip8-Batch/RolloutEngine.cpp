@@ -0,0 +1,61 @@
+#include "RolloutEngine.h"
+
+#include <utility>
+
+RolloutEngine::RolloutEngine(WorkStealingPool& pool)
+	: pool{ pool }
+{
+	for (unsigned i{ 0 }; i < pool.threads(); ++i)
+	{
+		machines.push_back(std::make_unique<Chip8>());
+	}
+}
+
+std::vector<double> RolloutEngine::evaluate(const Chip8::State& root, const std::vector<input_sequence_type>& sequences, const scorer_type& scorer)
+{
+	std::vector<double> scores(sequences.size(), 0.0);
+
+	pool.run(sequences.size(), [&](std::size_t index, unsigned worker)
+	{
+		Chip8& chip8{ *machines[worker] };
+		chip8.restore(root);
+
+		Chip8::keypad_type& keypad{ chip8.getKeypad() };
+		double score{ 0.0 };
+		std::uint32_t frames{ 0 };
+		for (std::uint16_t keys : sequences[index])
+		{
+			for (int key{ 0 }; key < Chip8::KEY_COUNT; ++key)
+			{
+				keypad[key] = (keys >> key) & 1;
+			}
+
+			chip8.runFrame();
+			if (scorer(chip8, ++frames, score)) break;
+		}
+
+		scores[index] = score;
+	});
+
+	return scores;
+}
+
+RolloutEngine::scorer_type RolloutEngine::memoryScore(std::uint16_t address)
+{
+	return [address](const Chip8& chip8, std::uint32_t, double& score)
+	{
+		score = chip8.getMemory()[address % Chip8::MEMORY_SIZE];
+		return false;
+	};
+}
+
+RolloutEngine::scorer_type RolloutEngine::framesUntil(std::function<bool(const Chip8&)> predicate)
+{
+	return [predicate = std::move(predicate)](const Chip8& chip8, std::uint32_t frames, double& score)
+	{
+		if (predicate(chip8)) return true;
+
+		score = frames;
+		return false;
+	};
+}
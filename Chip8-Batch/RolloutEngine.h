@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Chip8.h"
+#include "WorkStealingPool.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Plays many input sequences forward from one root state in parallel and scores each, for game-tree search.
+// Every worker restores the root into its own Chip8 before each rollout, so nothing is allocated per rollout.
+class RolloutEngine
+{
+public:
+	// Keys held for each frame in turn, bit n is key n
+	using input_sequence_type = std::vector<std::uint16_t>;
+
+	// Called after every frame with the number of frames run so far, and may update score.
+	// Returning true ends the rollout there.
+	using scorer_type = std::function<bool(const Chip8& chip8, std::uint32_t frames, double& score)>;
+
+	explicit RolloutEngine(WorkStealingPool& pool);
+
+	// One score per sequence, in the same order. Each frame is one Chip8::runFrame() call
+	std::vector<double> evaluate(const Chip8::State& root, const std::vector<input_sequence_type>& sequences, const scorer_type& scorer);
+
+	// Score is the byte at address when the rollout ends, such as a game's score or lives counter
+	static scorer_type memoryScore(std::uint16_t address);
+
+	// Score is the number of frames run before predicate first held, ending the rollout there
+	static scorer_type framesUntil(std::function<bool(const Chip8&)> predicate);
+
+private:
+	WorkStealingPool& pool;
+	std::vector<std::unique_ptr<Chip8>> machines{};		// One per worker, reused for every rollout
+};
@@ -0,0 +1,88 @@
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <thread>
+
+WorkStealingPool::WorkStealingPool(unsigned threads)
+	: threadCount{ std::max(threads, 1u) }
+{
+	for (unsigned i{ 0 }; i < threadCount; ++i)
+	{
+		queues.push_back(std::make_unique<Queue>());
+	}
+}
+
+void WorkStealingPool::run(std::size_t jobCount, const std::function<void(std::size_t)>& job)
+{
+	run(jobCount, [&job](std::size_t index, unsigned)
+	{
+		job(index);
+	});
+}
+
+void WorkStealingPool::run(std::size_t jobCount, const std::function<void(std::size_t, unsigned)>& job)
+{
+	stealCount = 0;
+
+	// Contiguous shares, so neighbouring jobs (usually the same ROM) stay on one core
+	for (unsigned i{ 0 }; i < threadCount; ++i)
+	{
+		std::size_t first{ jobCount * i / threadCount };
+		std::size_t last{ jobCount * (i + 1) / threadCount };
+		for (std::size_t index{ first }; index < last; ++index)
+		{
+			queues[i]->jobs.push_back(index);
+		}
+	}
+
+	// The calling thread works as worker 0
+	std::vector<std::thread> workers{};
+	for (unsigned i{ 1 }; i < threadCount; ++i)
+	{
+		workers.emplace_back(&WorkStealingPool::work, this, i, std::cref(job));
+	}
+	work(0, job);
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void WorkStealingPool::work(unsigned self, const std::function<void(std::size_t, unsigned)>& job)
+{
+	std::size_t index{};
+	while (popOwn(self, index) || steal(self, index))
+	{
+		job(index, self);
+	}
+}
+
+bool WorkStealingPool::popOwn(unsigned self, std::size_t& index)
+{
+	Queue& queue{ *queues[self] };
+	std::lock_guard<std::mutex> lock{ queue.mutex };
+	if (queue.jobs.empty()) return false;
+
+	index = queue.jobs.back();
+	queue.jobs.pop_back();
+	return true;
+}
+
+// Jobs never create more jobs, so once every other deque is empty the worker is finished
+bool WorkStealingPool::steal(unsigned self, std::size_t& index)
+{
+	for (unsigned offset{ 1 }; offset < threadCount; ++offset)
+	{
+		Queue& victim{ *queues[(self + offset) % threadCount] };
+		std::lock_guard<std::mutex> lock{ victim.mutex };
+		if (victim.jobs.empty()) continue;
+
+		index = victim.jobs.front();
+		victim.jobs.pop_front();
+		++stealCount;
+		return true;
+	}
+
+	return false;
+}
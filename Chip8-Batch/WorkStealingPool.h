@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Runs a batch of independent jobs, identified by index, on a fixed number of threads.
+// Every worker starts with an equal contiguous share of the jobs and works through its own deque from the back.
+// Once that is empty it steals from the front of another worker's deque, so long jobs don't leave cores idle.
+class WorkStealingPool
+{
+public:
+	explicit WorkStealingPool(unsigned threads);
+
+	// Blocks until job(i) has returned for every i in [0, jobCount)
+	void run(std::size_t jobCount, const std::function<void(std::size_t)>& job);
+
+	// Also passes the worker running the job, in [0, threads()), for jobs that keep per-worker scratch state
+	void run(std::size_t jobCount, const std::function<void(std::size_t, unsigned)>& job);
+
+	unsigned threads() const
+	{
+		return threadCount;
+	}
+
+	// Jobs taken from another worker's deque during the last run()
+	std::size_t steals() const
+	{
+		return stealCount;
+	}
+
+private:
+	struct Queue
+	{
+		std::mutex mutex{};
+		std::deque<std::size_t> jobs{};
+	};
+
+	unsigned threadCount{};
+	std::vector<std::unique_ptr<Queue>> queues{};
+	std::atomic<std::size_t> stealCount{ 0 };
+
+	void work(unsigned self, const std::function<void(std::size_t, unsigned)>& job);
+	bool popOwn(unsigned self, std::size_t& index);
+	bool steal(unsigned self, std::size_t& index);
+};
@@ -0,0 +1,177 @@
+#include "BenchmarkRunner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <regex>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+namespace
+{
+	constexpr std::uint64_t MAX_ITERATIONS{ 1000000000 };
+
+	volatile std::uint64_t kept{ 0 };
+
+	double itemsPerSecond(const BenchmarkRunner::Result& result)
+	{
+		double seconds{ result.realNs * static_cast<double>(result.iterations) / 1e9 };
+		return (seconds > 0.0) ? static_cast<double>(result.items) / seconds : 0.0;
+	}
+}
+
+void BenchmarkRunner::add(const std::string& name, const std::string& itemName, body_type body)
+{
+	benchmarks.push_back(Benchmark{ name, itemName, std::move(body) });
+}
+
+bool BenchmarkRunner::run(const std::string& filter, double minimumMs, int repetitions, std::ostream& progress)
+{
+	std::regex pattern{};
+	try
+	{
+		pattern = std::regex{ filter };
+	}
+	catch (const std::regex_error&)
+	{
+		progress << "Invalid filter " << filter << std::endl;
+		return false;
+	}
+
+	progress << std::left << std::setw(40) << "Benchmark" << std::right << std::setw(14) << "Time" << std::setw(14)
+		<< "CPU" << std::setw(14) << "Iterations" << "  Items/s" << '\n' << std::string(100, '-') << std::endl;
+
+	for (const Benchmark& benchmark : benchmarks)
+	{
+		if (!filter.empty() && !std::regex_search(benchmark.name, pattern)) continue;
+
+		Result result{ measure(benchmark, minimumMs, repetitions) };
+		progress << std::left << std::setw(40) << result.name << std::right << std::fixed << std::setprecision(1)
+			<< std::setw(11) << result.realNs << " ns" << std::setw(11) << result.cpuNs << " ns" << std::setw(14)
+			<< result.iterations << "  " << std::setprecision(3) << itemsPerSecond(result) / 1e6 << "M "
+			<< result.itemName << "/s" << std::endl;
+		results.push_back(result);
+	}
+	return true;
+}
+
+BenchmarkRunner::Result BenchmarkRunner::measure(const Benchmark& benchmark, double minimumMs, int repetitions)
+{
+	Result fastest{ benchmark.name, benchmark.itemName };
+
+	auto timeRun = [&](std::uint64_t iterations)
+	{
+		std::clock_t cpuStart{ std::clock() };
+		auto start = std::chrono::steady_clock::now();
+		std::uint64_t items{ benchmark.body(iterations) };
+		double realMs{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() };
+		double cpuMs{ 1000.0 * static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC };
+
+		if (fastest.iterations == 0 || realMs * 1e6 / static_cast<double>(iterations) < fastest.realNs)
+		{
+			fastest.iterations = iterations;
+			fastest.items = items;
+			fastest.realNs = realMs * 1e6 / static_cast<double>(iterations);
+			fastest.cpuNs = cpuMs * 1e6 / static_cast<double>(iterations);
+		}
+		return realMs;
+	};
+
+	// Aim 40% past the minimum so the next run usually clears it. A run under a tenth of the minimum says too little
+	// about the rate, so grow tenfold instead.
+	std::uint64_t iterations{ 1 };
+	for (;;)
+	{
+		fastest = Result{ benchmark.name, benchmark.itemName };
+		double realMs{ timeRun(iterations) };
+		if (realMs >= minimumMs || iterations >= MAX_ITERATIONS) break;
+
+		double multiplier{ (realMs > minimumMs / 10.0) ? minimumMs * 1.4 / realMs : 10.0 };
+		iterations = std::min(std::max(static_cast<std::uint64_t>(static_cast<double>(iterations) * multiplier), iterations + 1), MAX_ITERATIONS);
+	}
+
+	for (int repetition{ 1 }; repetition < repetitions; ++repetition)
+	{
+		timeRun(iterations);
+	}
+	return fastest;
+}
+
+void BenchmarkRunner::writeJson(std::ostream& out, const std::string& label) const
+{
+	out << "{\n  \"context\": {\n"
+		<< "    \"timestamp\": " << static_cast<long long>(std::time(nullptr)) << ",\n"
+		<< "    \"label\": \"" << escapeJson(label) << "\",\n"
+		<< "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+#if defined(NDEBUG)
+		<< "    \"library_build_type\": \"release\",\n"
+#else
+		<< "    \"library_build_type\": \"debug\",\n"
+#endif
+#if defined(CHIP8_PROFILE)
+		<< "    \"chip8_profile\": true\n"
+#else
+		<< "    \"chip8_profile\": false\n"
+#endif
+		<< "  },\n  \"benchmarks\": [";
+
+	for (std::size_t i{ 0 }; i < results.size(); ++i)
+	{
+		const Result& result{ results[i] };
+		out << (i == 0 ? "\n" : ",\n") << "    {\n"
+			<< "      \"name\": \"" << escapeJson(result.name) << "\",\n"
+			<< "      \"run_name\": \"" << escapeJson(result.name) << "\",\n"
+			<< "      \"run_type\": \"iteration\",\n"
+			<< "      \"repetitions\": 1,\n"
+			<< "      \"repetition_index\": 0,\n"
+			<< "      \"threads\": 1,\n"
+			<< "      \"iterations\": " << result.iterations << ",\n"
+			<< std::setprecision(6) << std::fixed
+			<< "      \"real_time\": " << result.realNs << ",\n"
+			<< "      \"cpu_time\": " << result.cpuNs << ",\n"
+			<< "      \"time_unit\": \"ns\",\n"
+			<< std::setprecision(1)
+			<< "      \"items_per_second\": " << itemsPerSecond(result) << ",\n"
+			<< "      \"label\": \"" << escapeJson(result.itemName) << "\"\n"
+			<< "    }";
+	}
+	out << "\n  ]\n}\n";
+}
+
+void BenchmarkRunner::writeCsv(std::ostream& out) const
+{
+	out << "name,label,iterations,real_ns,cpu_ns,items_per_second\n";
+	for (const Result& result : results)
+	{
+		out << result.name << ',' << result.itemName << ',' << result.iterations << ',' << std::fixed << std::setprecision(3)
+			<< result.realNs << ',' << result.cpuNs << ',' << std::setprecision(0) << itemsPerSecond(result) << '\n';
+	}
+}
+
+void BenchmarkRunner::keep(std::uint64_t value)
+{
+	kept = kept + value;
+}
+
+std::string BenchmarkRunner::escapeJson(const std::string& text)
+{
+	std::ostringstream escaped{};
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			escaped << '\\' << c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+		}
+		else
+		{
+			escaped << c;
+		}
+	}
+	return escaped.str();
+}
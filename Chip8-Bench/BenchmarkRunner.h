@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Times named benchmarks the way Google Benchmark does. Each one is run with a growing iteration count until a run
+// takes long enough to trust, then repeated with that count, keeping the fastest repetition.
+class BenchmarkRunner
+{
+public:
+	// Does the benchmark's work iterations times, returns how many items (instructions, handler calls, frames) that
+	// processed
+	using body_type = std::function<std::uint64_t(std::uint64_t iterations)>;
+
+	struct Result
+	{
+		std::string name{};
+		std::string itemName{};		// What the items are, reported as the label
+		std::uint64_t iterations{};
+		std::uint64_t items{};		// In one repetition
+		double realNs{};			// Per iteration, of the fastest repetition
+		double cpuNs{};				// Per iteration, of the same repetition
+	};
+
+	void add(const std::string& name, const std::string& itemName, body_type body);
+
+	// Runs every benchmark whose name matches the filter regex, or all of them for an empty filter. Each result is
+	// printed as it finishes. Returns false if the filter is not a valid regex.
+	bool run(const std::string& filter, double minimumMs, int repetitions, std::ostream& progress);
+
+	// Google Benchmark's JSON layout, so its compare.py can diff two runs. label, such as a commit id, goes in the
+	// context along with the Unix time.
+	void writeJson(std::ostream& out, const std::string& label) const;
+
+	// One row per benchmark: name,label,iterations,real_ns,cpu_ns,items_per_second
+	void writeCsv(std::ostream& out) const;
+
+	// Stores value where the compiler can't tell it goes unused, so the work producing it isn't optimised away
+	static void keep(std::uint64_t value);
+
+private:
+	struct Benchmark
+	{
+		std::string name{};
+		std::string itemName{};
+		body_type body{};
+	};
+
+	std::vector<Benchmark> benchmarks{};
+	std::vector<Result> results{};
+
+	static Result measure(const Benchmark& benchmark, double minimumMs, int repetitions);
+	static std::string escapeJson(const std::string& text);
+};
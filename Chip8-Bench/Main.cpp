@@ -0,0 +1,88 @@
+#include "BenchmarkRunner.h"
+#include "Microbenchmarks.h"
+#include "RomBenchmarks.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[])
+{
+	std::string filter{};
+	double minimumMs{ 100.0 };
+	int repetitions{ 3 };
+	std::string romDirectory{ "roms" };
+	std::string jsonPath{};
+	std::string csvPath{};
+	std::string label{};
+
+	for (int arg{ 1 }; arg < argc; ++arg)
+	{
+		const std::string option{ argv[arg] };
+		bool hasValue{ arg + 1 < argc };
+		if (option == "--filter" && hasValue)
+		{
+			filter = argv[++arg];
+		}
+		else if (option == "--min-ms" && hasValue)
+		{
+			minimumMs = std::stod(argv[++arg]);
+		}
+		else if (option == "--repetitions" && hasValue)
+		{
+			repetitions = std::stoi(argv[++arg]);
+		}
+		else if (option == "--roms" && hasValue)
+		{
+			romDirectory = argv[++arg];
+		}
+		else if (option == "--json" && hasValue)
+		{
+			jsonPath = argv[++arg];
+		}
+		else if (option == "--csv" && hasValue)
+		{
+			csvPath = argv[++arg];
+		}
+		else if (option == "--label" && hasValue)
+		{
+			label = argv[++arg];
+		}
+		else
+		{
+			std::cout << "Usage: Chip8-Bench [--filter <regex>] [--min-ms <ms>] [--repetitions <n>] [--roms <directory>] "
+				"[--json <results.json>] [--csv <results.csv>] [--label <text>]" << std::endl;
+			return 1;
+		}
+	}
+
+	BenchmarkRunner runner{};
+	if (!Microbenchmarks::registerAll(runner)) return 1;
+	if (!RomBenchmarks::registerAll(runner, romDirectory)) return 1;
+
+	if (!runner.run(filter, minimumMs, repetitions, std::cout)) return 1;
+
+	if (!jsonPath.empty())
+	{
+		std::ofstream json{ jsonPath };
+		if (!json)
+		{
+			std::cout << "Failed to open " << jsonPath << std::endl;
+			return 1;
+		}
+		runner.writeJson(json, label);
+	}
+
+	if (!csvPath.empty())
+	{
+		std::ofstream csv{ csvPath };
+		if (!csv)
+		{
+			std::cout << "Failed to open " << csvPath << std::endl;
+			return 1;
+		}
+		runner.writeCsv(csv);
+	}
+
+	return 0;
+}
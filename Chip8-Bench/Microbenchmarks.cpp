@@ -0,0 +1,194 @@
+#include "Microbenchmarks.h"
+#include "DisplayExpander.h"
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	constexpr std::uint16_t DATA_ADDRESS{ 0x300 };	// Where I points, clear of the end of memory for every handler
+}
+
+bool Microbenchmarks::registerAll(BenchmarkRunner& runner)
+{
+	registerFetch(runner);
+	registerHandlers(runner);
+	return registerDisplay(runner);
+}
+
+void Microbenchmarks::registerFetch(BenchmarkRunner& runner)
+{
+	std::shared_ptr<Chip8> chip8{ makeMachine(Chip8::Platform::SuperChip) };
+
+	// Walks through memory, starting over from MEM_START at the end
+	runner.add("fetch", "instructions", [chip8](std::uint64_t iterations)
+	{
+		std::uint64_t sum{ 0 };
+		for (std::uint64_t i{ 0 }; i < iterations; ++i)
+		{
+			sum += chip8->fetch();
+			if (chip8->pc > Chip8::MEMORY_SIZE - 2) chip8->pc = Chip8::MEM_START;
+		}
+		BenchmarkRunner::keep(sum);
+		return iterations;
+	});
+
+	runner.add("fetch/decodeInstruction", "instructions", [chip8](std::uint64_t iterations)
+	{
+		std::uint64_t sum{ 0 };
+		for (std::uint64_t i{ 0 }; i < iterations; ++i)
+		{
+			sum += static_cast<std::uint64_t>(Chip8::decodeInstruction(chip8->fetch()).op);
+			if (chip8->pc > Chip8::MEMORY_SIZE - 2) chip8->pc = Chip8::MEM_START;
+		}
+		BenchmarkRunner::keep(sum);
+		return iterations;
+	});
+
+	std::shared_ptr<Chip8> cached{ makeMachine(Chip8::Platform::SuperChip) };
+	cached->setDispatch(Chip8::Dispatch::Cached);
+	runner.add("fetch/fetchCached", "instructions", [cached](std::uint64_t iterations)
+	{
+		std::uint64_t sum{ 0 };
+		for (std::uint64_t i{ 0 }; i < iterations; ++i)
+		{
+			sum += static_cast<std::uint64_t>(cached->fetchCached().op);
+			if (cached->pc > Chip8::MEMORY_SIZE - 2) cached->pc = Chip8::MEM_START;
+		}
+		BenchmarkRunner::keep(sum);
+		return iterations;
+	});
+}
+
+void Microbenchmarks::registerHandlers(BenchmarkRunner& runner)
+{
+	// One row, a byte's worth and the tallest sprite, drawn at shifting positions so most straddle two bytes of a row
+	for (int height : { 1, 8, 15 })
+	{
+		std::shared_ptr<Chip8> chip8{ makeMachine(Chip8::Platform::SuperChip) };
+		Chip8::Instruction draw{ Chip8::decodeInstruction(static_cast<std::uint16_t>(0xD010 | height)) };
+		runner.add("opcode_DXYN/" + std::to_string(height), "calls", [chip8, draw](std::uint64_t iterations)
+		{
+			chip8->ir = DATA_ADDRESS;
+			for (std::uint64_t i{ 0 }; i < iterations; ++i)
+			{
+				chip8->registers[0] = static_cast<std::uint8_t>(i * 7);
+				chip8->registers[1] = static_cast<std::uint8_t>(i * 3);
+				call(*chip8, draw);
+			}
+			BenchmarkRunner::keep(chip8->display[0]);
+			return iterations;
+		});
+	}
+
+	std::shared_ptr<Chip8> bcdMachine{ makeMachine(Chip8::Platform::SuperChip) };
+	Chip8::Instruction bcd{ Chip8::decodeInstruction(0xF533) };
+	runner.add("opcode_FX33", "calls", [bcdMachine, bcd](std::uint64_t iterations)
+	{
+		bcdMachine->ir = DATA_ADDRESS;
+		for (std::uint64_t i{ 0 }; i < iterations; ++i)
+		{
+			bcdMachine->registers[5] = static_cast<std::uint8_t>(i);
+			call(*bcdMachine, bcd);
+		}
+		BenchmarkRunner::keep(bcdMachine->memory[DATA_ADDRESS]);
+		return iterations;
+	});
+
+	// All sixteen registers, once with the VIP's I increment and once without
+	const std::pair<Chip8::Platform, const char*> platforms[]
+	{
+		{ Chip8::Platform::CosmacVip, "vip" },
+		{ Chip8::Platform::SuperChip, "schip" }
+	};
+	for (const auto& [platform, platformName] : platforms)
+	{
+		std::shared_ptr<Chip8> chip8{ makeMachine(platform) };
+		Chip8::Instruction store{ Chip8::decodeInstruction(0xFF55) };
+		runner.add(std::string{ "opcode_FX55/" } + platformName, "calls", [chip8, store](std::uint64_t iterations)
+		{
+			for (std::uint64_t i{ 0 }; i < iterations; ++i)
+			{
+				chip8->ir = DATA_ADDRESS;
+				chip8->registers[0] = static_cast<std::uint8_t>(i);
+				call(*chip8, store);
+			}
+			BenchmarkRunner::keep(chip8->memory[DATA_ADDRESS]);
+			return iterations;
+		});
+	}
+}
+
+bool Microbenchmarks::registerDisplay(BenchmarkRunner& runner)
+{
+	// About half the pixels lit, in no pattern a branch predictor could learn
+	std::shared_ptr<Chip8> chip8{ makeMachine(Chip8::Platform::SuperChip) };
+	Chip8::Rng rng{ 2 };
+	for (std::uint64_t& row : chip8->display)
+	{
+		row = (static_cast<std::uint64_t>(rng.next()) << 32) | rng.next();
+	}
+	const Chip8::display_type reference{ chip8->getDisplay() };
+
+	runner.add("getDisplay", "frames", [chip8](std::uint64_t iterations)
+	{
+		for (std::uint64_t i{ 0 }; i < iterations; ++i)
+		{
+			BenchmarkRunner::keep(chip8->getDisplay()[0]);
+		}
+		return iterations;
+	});
+
+	const std::pair<DisplayExpander::Kernel, const char*> kernels[]
+	{
+		{ DisplayExpander::Kernel::Scalar, "DisplayExpander/scalar" },
+		{ DisplayExpander::Kernel::Sse2, "DisplayExpander/sse2" },
+		{ DisplayExpander::Kernel::Avx2, "DisplayExpander/avx2" }
+	};
+	for (const auto& [kernel, name] : kernels)
+	{
+		if (!DisplayExpander::isSupported(kernel)) continue;
+
+		auto rgba{ std::make_shared<Chip8::display_type>() };
+		DisplayExpander::expand(chip8->display, *rgba, kernel);
+		if (*rgba != reference)
+		{
+			std::cout << name << " doesn't match Chip8::getDisplay()" << std::endl;
+			return false;
+		}
+
+		runner.add(name, "frames", [chip8, rgba, expandKernel = kernel](std::uint64_t iterations)
+		{
+			for (std::uint64_t i{ 0 }; i < iterations; ++i)
+			{
+				DisplayExpander::expand(chip8->display, *rgba, expandKernel);
+				BenchmarkRunner::keep((*rgba)[0]);
+			}
+			return iterations;
+		});
+	}
+	return true;
+}
+
+std::shared_ptr<Chip8> Microbenchmarks::makeMachine(Chip8::Platform platform)
+{
+	auto chip8{ std::make_shared<Chip8>() };
+	chip8->setPlatform(platform);
+
+	Chip8::Rng rng{ 1 };
+	std::vector<std::uint8_t> rom(Chip8::MAX_ROM_SIZE);
+	for (std::uint8_t& byte : rom)
+	{
+		byte = static_cast<std::uint8_t>(rng.next());
+	}
+	chip8->loadRom(rom);
+	chip8->seedRng(1);
+	return chip8;
+}
+
+void Microbenchmarks::call(Chip8& chip8, const Chip8::Instruction& inst)
+{
+	(chip8.*(*chip8.profile->handlers)[static_cast<std::size_t>(inst.op)])(inst);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "BenchmarkRunner.h"
+#include "Chip8.h"
+
+#include <memory>
+
+// Benchmarks of single pieces of the interpreter, a friend of Chip8 so each handler can be timed on its own.
+// Handlers are called through the platform's handler table, the way Dispatch::Table calls them.
+class Microbenchmarks
+{
+public:
+	// Returns false if a DisplayExpander kernel doesn't give the same picture as Chip8::getDisplay()
+	static bool registerAll(BenchmarkRunner& runner);
+
+private:
+	static void registerFetch(BenchmarkRunner& runner);
+	static void registerHandlers(BenchmarkRunner& runner);
+	static bool registerDisplay(BenchmarkRunner& runner);
+
+	// Memory from MEM_START up is filled with random bytes, so handlers read and write something like a ROM
+	static std::shared_ptr<Chip8> makeMachine(Chip8::Platform platform);
+	static void call(Chip8& chip8, const Chip8::Instruction& inst);
+};
@@ -0,0 +1,124 @@
+#include "RomBenchmarks.h"
+#include "Chip8Jit.h"
+
+#if defined(CHIP8_AOT_PROGRAMS)
+#include "AotPrograms.h"
+#endif
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+namespace
+{
+	// Tapped in the same order as Chip8-Regression/input/sweep.txt, one every 30 frames and held for 10
+	constexpr std::uint8_t KEY_ORDER[]{ 0x5, 0x4, 0x6, 0x1, 0x2, 0x3, 0xC, 0x7, 0x8, 0x9, 0xE, 0xA, 0x0, 0xB, 0xF, 0xD };
+	constexpr std::uint32_t KEY_INTERVAL{ 30 };
+	constexpr std::uint32_t KEY_HELD{ 10 };
+
+	void pressKeys(Chip8& chip8, std::uint32_t frame)
+	{
+		Chip8::keypad_type& keypad{ chip8.getKeypad() };
+		keypad.fill(0);
+		if (frame >= KEY_INTERVAL && frame % KEY_INTERVAL < KEY_HELD)
+		{
+			keypad[KEY_ORDER[(frame / KEY_INTERVAL - 1) % std::size(KEY_ORDER)]] = 1;
+		}
+	}
+}
+
+bool RomBenchmarks::registerAll(BenchmarkRunner& runner, const std::string& directory)
+{
+	std::error_code error{};
+	std::vector<std::filesystem::path> paths{};
+	for (const auto& entry : std::filesystem::directory_iterator{ directory, error })
+	{
+		std::filesystem::path extension{ entry.path().extension() };
+		if (entry.is_regular_file() && (extension.empty() || extension == ".ch8")) paths.push_back(entry.path());
+	}
+	if (error || paths.empty())
+	{
+		std::cout << "No ROMs found in " << directory << std::endl;
+		return false;
+	}
+	std::sort(paths.begin(), paths.end());
+
+	std::vector<std::pair<Engine, const char*>> engines
+	{
+		{ Engine::Switch, "switch" },
+		{ Engine::Run, "run" },
+		{ Engine::RunCached, "run-cached" }
+	};
+	if (Chip8Jit::isSupported()) engines.emplace_back(Engine::Jit, "jit");
+
+	for (const std::filesystem::path& path : paths)
+	{
+		std::ifstream romFile{ path, std::ios::binary };
+		auto rom{ std::make_shared<std::vector<std::uint8_t>>(std::istreambuf_iterator<char>(romFile), std::istreambuf_iterator<char>()) };
+		if (rom->size() > Chip8::MAX_ROM_SIZE) continue;
+
+		const std::string filename{ path.string() };
+		std::vector<std::pair<Engine, const char*>> romEngines{ engines };
+		const Chip8Aot::Program* aotProgram{ nullptr };
+#if defined(CHIP8_AOT_PROGRAMS)
+		aotProgram = AotPrograms::find(path.filename().string());
+		if (aotProgram) romEngines.emplace_back(Engine::Aot, "aot");
+#endif
+
+		for (const auto& [engine, engineName] : romEngines)
+		{
+			runner.add("rom/" + path.filename().string() + '/' + engineName, "instructions",
+				[filename, rom, playEngine = engine, aotProgram](std::uint64_t iterations)
+			{
+				std::uint64_t instructions{ 0 };
+				for (std::uint64_t i{ 0 }; i < iterations; ++i)
+				{
+					instructions += play(filename, *rom, playEngine, aotProgram);
+				}
+				return instructions;
+			});
+		}
+	}
+	return true;
+}
+
+std::uint64_t RomBenchmarks::play(const std::string& filename, const std::vector<std::uint8_t>& rom, Engine engine,
+	const Chip8Aot::Program* aotProgram)
+{
+	auto chip8{ std::make_unique<Chip8>() };
+	chip8->setPlatform(Chip8::platformForRom(filename));
+	chip8->setDispatch((engine == Engine::Switch) ? Chip8::Dispatch::Switch
+		: (engine == Engine::RunCached) ? Chip8::Dispatch::Cached : Chip8::Dispatch::Table);
+	chip8->setInstructionsPerFrame(INSTRUCTIONS_PER_FRAME);
+	chip8->loadRom(rom);
+	chip8->seedRng(1);
+
+	std::unique_ptr<Chip8Jit> jit{ (engine == Engine::Jit) ? std::make_unique<Chip8Jit>(*chip8) : nullptr };
+	std::unique_ptr<Chip8Aot> aot{ (engine == Engine::Aot) ? std::make_unique<Chip8Aot>(*chip8, *aotProgram) : nullptr };
+
+	for (std::uint32_t frame{ 0 }; frame < FRAMES; ++frame)
+	{
+		pressKeys(*chip8, frame);
+		switch (engine)
+		{
+		case Engine::Switch:
+			for (std::uint32_t i{ 0 }; i < INSTRUCTIONS_PER_FRAME; ++i) chip8->cycle();
+			break;
+		case Engine::Run:
+		case Engine::RunCached:
+			chip8->runFrame();
+			break;
+		case Engine::Jit:
+			jit->run(INSTRUCTIONS_PER_FRAME);
+			break;
+		case Engine::Aot:
+			aot->run(INSTRUCTIONS_PER_FRAME);
+			break;
+		}
+	}
+	return chip8->getInstructionCount();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "BenchmarkRunner.h"
+#include "Chip8.h"
+#include "Chip8Aot.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Whole ROMs played headlessly, one benchmark per ROM and engine. Keys are tapped in turn so games get past their
+// title screens and into play. Items are emulated instructions, idle loops fast-forwarded by Chip8::run() included,
+// so items per second over a million is MIPS.
+class RomBenchmarks
+{
+public:
+	static constexpr std::uint32_t FRAMES{ 600 };
+	static constexpr std::uint32_t INSTRUCTIONS_PER_FRAME{ 1000 };	// Far past any real clock, to keep the core busy
+
+	// Every file in directory with no extension or ".ch8", in name order. Returns false if there are none.
+	static bool registerAll(BenchmarkRunner& runner, const std::string& directory);
+
+private:
+	enum class Engine
+	{
+		Switch,		// Chip8::cycle() with Dispatch::Switch
+		Run,		// Chip8::runFrame() with Dispatch::Table
+		RunCached,	// Chip8::runFrame() with Dispatch::Cached
+		Jit,		// Chip8Jit, x86-64 hosts only
+		Aot			// Chip8Aot, for ROMs the CMake build compiled ahead of time
+	};
+
+	// Plays the ROM for FRAMES frames, returns the instructions emulated. Engine::Aot runs aotProgram.
+	static std::uint64_t play(const std::string& filename, const std::vector<std::uint8_t>& rom, Engine engine,
+		const Chip8Aot::Program* aotProgram);
+};
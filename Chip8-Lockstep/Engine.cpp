@@ -0,0 +1,133 @@
+#include "Engine.h"
+
+#include <utility>
+
+namespace
+{
+	constexpr std::pair<Engine::Kind, const char*> ENGINE_NAMES[]
+	{
+		{ Engine::Kind::Switch, "switch" },
+		{ Engine::Kind::Table, "table" },
+		{ Engine::Kind::Cached, "cached" },
+		{ Engine::Kind::Run, "run" },
+		{ Engine::Kind::RunCached, "run-cached" },
+		{ Engine::Kind::Jit, "jit" },
+		{ Engine::Kind::Aot, "aot" },
+		{ Engine::Kind::Simd, "simd" }
+	};
+}
+
+Engine::Engine(Kind engineKind, const Chip8Aot::Program* aotProgram)
+	: kind{ engineKind },
+	chip8{ std::make_unique<Chip8>() },
+	program{ aotProgram }
+{
+	switch (kind)
+	{
+	case Kind::Switch:
+		chip8->setDispatch(Chip8::Dispatch::Switch);
+		break;
+	case Kind::Table:
+	case Kind::Run:
+		chip8->setDispatch(Chip8::Dispatch::Table);
+		break;
+	case Kind::Cached:
+	case Kind::RunCached:
+		chip8->setDispatch(Chip8::Dispatch::Cached);
+		break;
+	case Kind::Jit:
+		jit = std::make_unique<Chip8Jit>(*chip8);
+		break;
+	case Kind::Aot:
+	case Kind::Simd:
+		break;
+	}
+}
+
+bool Engine::parse(const std::string& text, Kind& parsed)
+{
+	for (const auto& [candidate, candidateName] : ENGINE_NAMES)
+	{
+		if (text == candidateName)
+		{
+			parsed = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* Engine::name(Kind engineKind)
+{
+	for (const auto& [candidate, candidateName] : ENGINE_NAMES)
+	{
+		if (engineKind == candidate) return candidateName;
+	}
+	return "unknown";
+}
+
+bool Engine::isSupported(Kind engineKind)
+{
+	switch (engineKind)
+	{
+	case Kind::Jit:
+		return Chip8Jit::isSupported();
+	case Kind::Aot:
+#if defined(CHIP8_AOT_PROGRAMS)
+		return true;
+#else
+		return false;	// Only the CMake build compiles any programs
+#endif
+	default:
+		return true;
+	}
+}
+
+void Engine::restore(const Chip8::State& state)
+{
+	chip8->restore(state);
+	if (jit) jit->flush();
+	if (kind == Kind::Aot) aot = std::make_unique<Chip8Aot>(*chip8, *program);
+	if (kind == Kind::Simd) simd = std::make_unique<Chip8Simd>(*chip8, 1);
+}
+
+void Engine::setKeys(std::uint16_t keys)
+{
+	Chip8::keypad_type& keypad{ chip8->getKeypad() };
+	for (int key{ 0 }; key < Chip8::KEY_COUNT; ++key)
+	{
+		keypad[key] = (keys >> key) & 1;
+	}
+	if (simd) simd->setKeys(0, keys);
+}
+
+void Engine::run(std::size_t instructions)
+{
+	switch (kind)
+	{
+	case Kind::Switch:
+	case Kind::Table:
+	case Kind::Cached:
+		for (std::size_t i{ 0 }; i < instructions; ++i) chip8->cycle();
+		break;
+	case Kind::Run:
+	case Kind::RunCached:
+		chip8->run(instructions);
+		break;
+	case Kind::Jit:
+		jit->run(instructions);
+		break;
+	case Kind::Aot:
+		aot->run(instructions);
+		break;
+	case Kind::Simd:
+		simd->run(instructions);
+		break;
+	}
+}
+
+Chip8::State Engine::fork()
+{
+	if (simd) simd->copyTo(0, *chip8);
+	return chip8->fork();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Chip8.h"
+#include "Chip8Aot.h"
+#include "Chip8Jit.h"
+#include "Chip8Simd.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// One way of executing a Chip8, behind a common interface so any two can be started from the same state and run
+// side by side
+class Engine
+{
+public:
+	enum class Kind
+	{
+		Switch,		// Chip8::cycle() with Dispatch::Switch
+		Table,		// Chip8::cycle() with Dispatch::Table
+		Cached,		// Chip8::cycle() with Dispatch::Cached
+		Run,		// Chip8::run() with Dispatch::Table, with lazy timers and idle loop fast-forwarding
+		RunCached,	// Chip8::run() with Dispatch::Cached
+		Jit,		// Chip8Jit, x86-64 hosts only
+		Aot,		// Chip8Aot running a program compiled by the CMake build, see Chip8-AOT/AotPrograms.h
+		Simd		// A single Chip8Simd lane
+	};
+
+	// aotProgram is only used by Kind::Aot, which needs the program compiled from the ROM it is given to run
+	explicit Engine(Kind engineKind, const Chip8Aot::Program* aotProgram = nullptr);
+
+	static bool parse(const std::string& text, Kind& parsed);
+	static const char* name(Kind engineKind);
+	static bool isSupported(Kind engineKind);
+
+	Kind getKind() const
+	{
+		return kind;
+	}
+
+	void restore(const Chip8::State& state);
+
+	// Bit n is set while key n is held
+	void setKeys(std::uint16_t keys);
+
+	void run(std::size_t instructions);
+
+	Chip8::State fork();
+
+private:
+	Kind kind;
+	std::unique_ptr<Chip8> chip8{};
+	std::unique_ptr<Chip8Jit> jit{};
+	const Chip8Aot::Program* program{};
+	std::unique_ptr<Chip8Aot> aot{};
+	std::unique_ptr<Chip8Simd> simd{};
+};
@@ -0,0 +1,283 @@
+#include "LockstepChecker.h"
+#include "Disassembler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+	std::string hex(unsigned value, int digits)
+	{
+		std::ostringstream text{};
+		text << "0x" << std::uppercase << std::hex << std::setw(digits) << std::setfill('0') << value;
+		return text.str();
+	}
+
+	struct Difference
+	{
+		std::string field{};
+		std::string expected{};
+		std::string actual{};
+	};
+
+	// Everything a ROM can observe, plus the clock. The keypad, the configuration and waitingForKey, which Chip8Simd
+	// doesn't keep, are left out.
+	bool agree(const Chip8::State& a, const Chip8::State& b)
+	{
+		return a.pc == b.pc && a.ir == b.ir && a.registers == b.registers && a.sp == b.sp && a.stack == b.stack
+			&& a.stackFaulted == b.stackFaulted && a.delayTimer == b.delayTimer && a.soundTimer == b.soundTimer
+			&& a.frameInstructions == b.frameInstructions && a.instructionCount == b.instructionCount && a.rng == b.rng
+			&& a.memory == b.memory && a.display == b.display;
+	}
+
+	// What agree() found different, for the report
+	std::vector<Difference> compare(const Chip8::State& a, const Chip8::State& b)
+	{
+		constexpr std::size_t MAX_LISTED{ 8 };	// Per array, the rest are only counted
+
+		std::vector<Difference> differences{};
+		auto add = [&](const std::string& field, unsigned expected, unsigned actual, int digits)
+		{
+			if (expected != actual) differences.push_back(Difference{ field, hex(expected, digits), hex(actual, digits) });
+		};
+
+		add("pc", a.pc, b.pc, 3);
+		add("I", a.ir, b.ir, 3);
+		for (int reg{ 0 }; reg < 16; ++reg)
+		{
+			std::ostringstream name{};
+			name << 'V' << std::uppercase << std::hex << reg;
+			add(name.str(), a.registers[reg], b.registers[reg], 2);
+		}
+		add("sp", a.sp, b.sp, 2);
+		for (std::size_t entry{ 0 }; entry < Chip8::STACK_SIZE; ++entry)
+		{
+			add("stack[" + std::to_string(entry) + "]", a.stack[entry], b.stack[entry], 3);
+		}
+		add("stack fault", a.stackFaulted, b.stackFaulted, 1);
+		add("delay timer", a.delayTimer, b.delayTimer, 2);
+		add("sound timer", a.soundTimer, b.soundTimer, 2);
+		add("frame instructions", a.frameInstructions, b.frameInstructions, 1);
+		if (a.instructionCount != b.instructionCount)
+		{
+			differences.push_back(Difference{ "instructions", std::to_string(a.instructionCount), std::to_string(b.instructionCount) });
+		}
+		if (a.rng != b.rng) differences.push_back(Difference{ "rng", "", "" });
+
+		std::size_t memoryDifferences{ 0 };
+		for (std::size_t address{ 0 }; address < Chip8::MEMORY_SIZE; ++address)
+		{
+			if (a.memory[address] != b.memory[address] && memoryDifferences++ < MAX_LISTED)
+			{
+				add("memory[" + hex(static_cast<unsigned>(address), 3) + "]", a.memory[address], b.memory[address], 2);
+			}
+		}
+		if (memoryDifferences > MAX_LISTED)
+		{
+			differences.push_back(Difference{ "memory", std::to_string(memoryDifferences) + " bytes differ", "" });
+		}
+
+		std::size_t rowDifferences{ 0 };
+		for (int row{ 0 }; row < Chip8::DISPLAY_HEIGHT; ++row)
+		{
+			if (a.display[row] != b.display[row] && rowDifferences++ < MAX_LISTED)
+			{
+				std::ostringstream expected{};
+				std::ostringstream actual{};
+				expected << std::hex << std::setw(16) << std::setfill('0') << a.display[row];
+				actual << std::hex << std::setw(16) << std::setfill('0') << b.display[row];
+				differences.push_back(Difference{ "display row " + std::to_string(row), expected.str(), actual.str() });
+			}
+		}
+		if (rowDifferences > MAX_LISTED)
+		{
+			differences.push_back(Difference{ "display", std::to_string(rowDifferences) + " rows differ", "" });
+		}
+
+		return differences;
+	}
+}
+
+LockstepChecker::LockstepChecker(Engine::Kind referenceKind, Engine::Kind candidateKind, std::size_t quantumLength,
+	const Chip8Aot::Program* aotProgram)
+	: reference{ referenceKind, aotProgram },
+	candidate{ candidateKind, aotProgram },
+	probe{ std::make_unique<Chip8>() },
+	quantum{ std::max<std::size_t>(quantumLength, 1) }
+{
+	probe->setDispatch(Chip8::Dispatch::Table);
+	trace.reserve(quantum);
+}
+
+bool LockstepChecker::check(const Chip8::State& start, std::size_t instructions, std::uint32_t keySeed)
+{
+	reference.restore(start);
+	candidate.restore(start);
+
+	Chip8::Rng keyRng{ keySeed };
+	Chip8::State before{ start };
+	std::size_t remaining{ instructions };
+	while (remaining > 0)
+	{
+		// Now and then hold a different key, or none
+		std::uint32_t draw{ keyRng.next() };
+		if ((draw & 0xF) == 0)
+		{
+			std::uint16_t keys{ static_cast<std::uint16_t>((draw & 0x10) ? 0 : 1 << ((draw >> 8) & 0xF)) };
+			reference.setKeys(keys);
+			candidate.setKeys(keys);
+			before = reference.fork();
+		}
+
+		std::size_t wanted{ std::min(quantum, remaining) };
+		std::size_t length{ traceQuantum(before, wanted) };
+		if (length > 0)
+		{
+			reference.run(length);
+			candidate.run(length);
+
+			Chip8::State expected{ reference.fork() };
+			Chip8::State actual{ candidate.fork() };
+			if (!agree(expected, actual))
+			{
+				report(before, expected, actual);
+				return false;
+			}
+
+			checked += length;
+			remaining -= length;
+			before = expected;
+		}
+
+		if (length < wanted)
+		{
+			++early;
+			return true;
+		}
+	}
+	return true;
+}
+
+// Runs up to length instructions on the probe from start, recording each one, and returns how many can be run
+// before the first unsafe one
+std::size_t LockstepChecker::traceQuantum(const Chip8::State& start, std::size_t length)
+{
+	probe->restore(start);
+	trace.clear();
+
+	Chip8::State state{ start };
+	for (std::size_t i{ 0 }; i < length; ++i)
+	{
+		if (!isSafe(state)) break;
+
+		trace.push_back(TraceEntry{ state.pc, static_cast<std::uint16_t>((state.memory[state.pc] << 8) | state.memory[state.pc + 1]) });
+		probe->cycle();
+		state = probe->fork();
+	}
+	return trace.size();
+}
+
+// The instruction at pc is one the core runs, and it only touches memory and keys that exist
+bool LockstepChecker::isSafe(const Chip8::State& state)
+{
+	if (state.pc > Chip8::MEMORY_SIZE - 2) return false;
+
+	std::uint16_t opcode{ static_cast<std::uint16_t>((state.memory[state.pc] << 8) | state.memory[state.pc + 1]) };
+	if (!Disassembler::isInstruction(opcode)) return false;
+
+	std::size_t x{ static_cast<std::size_t>((opcode >> 8) & 0xF) };
+	std::size_t end{ state.ir };	// One past the last byte the instruction reads or writes through I
+	switch (opcode & 0xF0FF)
+	{
+	case 0xE09E:
+	case 0xE0A1: return state.registers[x] < Chip8::KEY_COUNT;	// Indexes the keypad with VX
+	case 0xF033: end += 3; break;
+	case 0xF055:
+	case 0xF065: end += x + 1; break;
+	default:
+		if ((opcode & 0xF000) == 0xD000) end += opcode & 0xF;
+		break;
+	}
+	return end <= Chip8::MEMORY_SIZE;
+}
+
+void LockstepChecker::report(const Chip8::State& before, const Chip8::State& expected, const Chip8::State& actual) const
+{
+	const char* expectedName{ Engine::name(reference.getKind()) };
+	const char* actualName{ Engine::name(candidate.getKind()) };
+
+	std::cout << expectedName << " and " << actualName << " diverged in instructions " << before.instructionCount + 1
+		<< '-' << expected.instructionCount << ", starting at " << hex(before.pc, 3) << ":\n";
+
+	std::size_t first{ trace.size() > MAX_TRACE_LINES ? trace.size() - MAX_TRACE_LINES : 0 };
+	if (first > 0) std::cout << "  ... " << first << " earlier instructions\n";
+	for (std::size_t i{ first }; i < trace.size(); ++i)
+	{
+		std::cout << "  " << hex(trace[i].pc, 3) << "  " << std::uppercase << std::hex << std::setw(4) << std::setfill('0')
+			<< trace[i].opcode << std::dec << std::nouppercase << std::setfill(' ') << "  "
+			<< Disassembler::disassemble(trace[i].opcode, before.platform) << '\n';
+	}
+
+	std::cout << '\n' << std::left << std::setw(20) << "" << std::setw(18) << expectedName << actualName << '\n';
+	for (const Difference& difference : compare(expected, actual))
+	{
+		std::cout << std::setw(20) << difference.field << std::setw(18) << difference.expected << difference.actual << '\n';
+	}
+	std::cout << std::right << std::flush;
+}
+
+std::vector<std::uint8_t> LockstepChecker::randomProgram(Chip8::Rng& rng, std::size_t instructions)
+{
+	// The decode templates, with the operand bits each one leaves free
+	struct Template
+	{
+		std::uint16_t opcode;
+		std::uint16_t operands;
+	};
+	constexpr Template TEMPLATES[]
+	{
+		{ 0x00E0, 0x0000 }, { 0x00EE, 0x0000 }, { 0x1000, 0x0FFF }, { 0x2000, 0x0FFF }, { 0x3000, 0x0FFF },
+		{ 0x4000, 0x0FFF }, { 0x5000, 0x0FF0 }, { 0x6000, 0x0FFF }, { 0x7000, 0x0FFF }, { 0x8000, 0x0FF0 },
+		{ 0x8001, 0x0FF0 }, { 0x8002, 0x0FF0 }, { 0x8003, 0x0FF0 }, { 0x8004, 0x0FF0 }, { 0x8005, 0x0FF0 },
+		{ 0x8006, 0x0FF0 }, { 0x8007, 0x0FF0 }, { 0x800E, 0x0FF0 }, { 0x9000, 0x0FF0 }, { 0xA000, 0x0FFF },
+		{ 0xB000, 0x0FFF }, { 0xC000, 0x0FFF }, { 0xD000, 0x0FFF }, { 0xE09E, 0x0F00 }, { 0xE0A1, 0x0F00 },
+		{ 0xF007, 0x0F00 }, { 0xF00A, 0x0F00 }, { 0xF015, 0x0F00 }, { 0xF018, 0x0F00 }, { 0xF01E, 0x0F00 },
+		{ 0xF029, 0x0F00 }, { 0xF033, 0x0F00 }, { 0xF055, 0x0F00 }, { 0xF065, 0x0F00 }
+	};
+	constexpr std::uint32_t PROGRAM_START{ 0x200 };
+	constexpr std::uint32_t DATA_END{ 0xF00 };
+
+	instructions = std::clamp<std::size_t>(instructions, 2, (DATA_END - PROGRAM_START) / 4);
+	std::uint32_t programEnd{ static_cast<std::uint32_t>(PROGRAM_START + 2 * instructions) };
+
+	// An even address inside the program
+	auto codeAddress = [&]() { return PROGRAM_START + 2 * (rng.next() % static_cast<std::uint32_t>(instructions)); };
+
+	std::vector<std::uint8_t> program{};
+	for (std::size_t i{ 0 }; i + 1 < instructions; ++i)
+	{
+		const Template& pick{ TEMPLATES[rng.next() % std::size(TEMPLATES)] };
+		std::uint32_t opcode{ pick.opcode | (rng.next() & pick.operands) };
+		switch (pick.opcode)
+		{
+		case 0x1000:
+		case 0x2000:
+		case 0xB000:
+			opcode = (opcode & 0xF000) | codeAddress();
+			break;
+		case 0xA000:
+			opcode = 0xA000 | (((rng.next() & 7) == 0) ? codeAddress() : programEnd + rng.next() % (DATA_END - programEnd));
+			break;
+		}
+
+		program.push_back(static_cast<std::uint8_t>(opcode >> 8));
+		program.push_back(static_cast<std::uint8_t>(opcode));
+	}
+
+	program.push_back(static_cast<std::uint8_t>(0x10 | (PROGRAM_START >> 8)));
+	program.push_back(static_cast<std::uint8_t>(PROGRAM_START));
+	return program;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Chip8.h"
+#include "Engine.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Runs two engines side by side from the same state, compares everything a ROM can observe after every quantum of
+// instructions, and reports the first quantum where they disagree
+class LockstepChecker
+{
+public:
+	// A quantum of 1 compares after every instruction. Larger ones let block-based engines such as the JIT run
+	// whole blocks, which they only do when given enough instructions. An aot engine runs aotProgram.
+	LockstepChecker(Engine::Kind referenceKind, Engine::Kind candidateKind, std::size_t quantumLength,
+		const Chip8Aot::Program* aotProgram = nullptr);
+
+	// Runs both engines from start for up to the given number of instructions, pressing random keys between quanta.
+	// Chip8 doesn't bounds check, so a run ends early, and still passes, just before an instruction that would reach
+	// outside memory or the keypad, or that the core ignores. Prints the divergence and returns false if the engines disagree.
+	bool check(const Chip8::State& start, std::size_t instructions, std::uint32_t keySeed);
+
+	// Instructions both engines ran and agreed on, over every check()
+	std::uint64_t instructionsChecked() const
+	{
+		return checked;
+	}
+
+	// Checks that ended before running every instruction they were given
+	std::size_t endedEarly() const
+	{
+		return early;
+	}
+
+	// Random instructions for loading at 0x200, ending in a jump back to the start. Jumps and calls land inside the
+	// program, and I mostly points past it, though now and then at the program itself so it rewrites its own code.
+	static std::vector<std::uint8_t> randomProgram(Chip8::Rng& rng, std::size_t instructions);
+
+private:
+	struct TraceEntry
+	{
+		std::uint16_t pc{};
+		std::uint16_t opcode{};
+	};
+
+	static constexpr std::size_t MAX_TRACE_LINES{ 32 };	// Of a diverging quantum, the ones leading up to the end
+
+	Engine reference;
+	Engine candidate;
+	std::unique_ptr<Chip8> probe{};		// Steps each quantum ahead of the engines with Chip8::cycle()
+	std::size_t quantum;
+	std::vector<TraceEntry> trace{};	// Instructions of the current quantum, as the probe ran them
+	std::uint64_t checked{ 0 };
+	std::size_t early{ 0 };
+
+	std::size_t traceQuantum(const Chip8::State& start, std::size_t length);
+	static bool isSafe(const Chip8::State& state);
+	void report(const Chip8::State& before, const Chip8::State& expected, const Chip8::State& actual) const;
+};
@@ -0,0 +1,135 @@
+#include "Chip8.h"
+#include "Engine.h"
+#include "LockstepChecker.h"
+
+#if defined(CHIP8_AOT_PROGRAMS)
+#include "AotPrograms.h"
+#endif
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+	void printUsage()
+	{
+		std::cout << "Usage: Chip8-Lockstep [--quantum <instructions>] <reference> <candidate> rom <rom> <instructions> [seed]\n"
+			"       Chip8-Lockstep [--quantum <instructions>] <reference> <candidate> random <programs> <instructions> [seed]\n"
+			"Engines: switch, table, cached, run, run-cached, jit, aot, simd" << std::endl;
+	}
+
+	bool parseEngine(const std::string& name, Engine::Kind& kind)
+	{
+		if (!Engine::parse(name, kind))
+		{
+			std::cout << "Unknown engine " << name << std::endl;
+			return false;
+		}
+		if (!Engine::isSupported(kind))
+		{
+			std::cout << name << " is not supported on this host" << std::endl;
+			return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::size_t quantum{ 1 };
+	if (argc > 2 && std::string{ argv[1] } == "--quantum")
+	{
+		quantum = std::stoul(argv[2]);
+		argc -= 2;
+		argv += 2;
+	}
+
+	if (argc < 6)
+	{
+		printUsage();
+		return 1;
+	}
+
+	Engine::Kind referenceKind{};
+	Engine::Kind candidateKind{};
+	if (!parseEngine(argv[1], referenceKind) || !parseEngine(argv[2], candidateKind)) return 1;
+
+	const std::string mode{ argv[3] };
+	std::size_t instructions{ std::stoul(argv[5]) };
+	std::uint32_t seed{ (argc > 6) ? static_cast<std::uint32_t>(std::stoul(argv[6])) : 1 };
+
+	// The aot engine runs the program the build compiled from the same ROM
+	const Chip8Aot::Program* aotProgram{ nullptr };
+	if (referenceKind == Engine::Kind::Aot || candidateKind == Engine::Kind::Aot)
+	{
+#if defined(CHIP8_AOT_PROGRAMS)
+		const std::string romPath{ argv[4] };
+		if (mode == "rom") aotProgram = AotPrograms::find(romPath.substr(romPath.find_last_of("/\\") + 1));
+#endif
+		if (!aotProgram)
+		{
+			std::cout << "aot can only run a ROM from roms/, which the build compiles ahead of time" << std::endl;
+			return 1;
+		}
+	}
+
+	LockstepChecker checker{ referenceKind, candidateKind, quantum, aotProgram };
+	auto chip8{ std::make_unique<Chip8>() };
+	std::size_t runs{ 0 };
+	bool agreed{ true };
+
+	if (mode == "rom")
+	{
+		const std::string romPath{ argv[4] };
+		std::ifstream romFile{ romPath, std::ios::binary };
+		if (!romFile)
+		{
+			std::cout << "File not found: " << romPath << std::endl;
+			return 1;
+		}
+
+		std::vector<std::uint8_t> rom{ std::istreambuf_iterator<char>(romFile), std::istreambuf_iterator<char>() };
+		chip8->setPlatform(Chip8::platformForRom(romPath));
+		if (!chip8->loadRom(rom)) return 1;
+		chip8->seedRng(seed);
+
+		agreed = checker.check(chip8->fork(), instructions, seed);
+		runs = 1;
+	}
+	else if (mode == "random")
+	{
+		// Every program gets its own length and platform, the same ones for the same seed
+		std::size_t programs{ std::stoul(argv[4]) };
+		Chip8::Rng rng{ seed };
+		const Chip8::Platform platforms[]{ Chip8::Platform::CosmacVip, Chip8::Platform::SuperChip, Chip8::Platform::XoChip };
+
+		for (; runs < programs && agreed; ++runs)
+		{
+			std::vector<std::uint8_t> program{ LockstepChecker::randomProgram(rng, 8 + rng.next() % 256) };
+
+			chip8 = std::make_unique<Chip8>();
+			chip8->setPlatform(platforms[runs % std::size(platforms)]);
+			chip8->loadRom(program);
+			chip8->seedRng(rng.next());
+
+			agreed = checker.check(chip8->fork(), instructions, rng.next());
+		}
+	}
+	else
+	{
+		printUsage();
+		return 1;
+	}
+
+	if (!agreed) return 1;
+
+	std::cout << Engine::name(referenceKind) << " and " << Engine::name(candidateKind) << " agreed on "
+		<< checker.instructionsChecked() << " instructions over " << runs << (runs == 1 ? " run" : " runs")
+		<< ", comparing every " << quantum << ". " << checker.endedEarly()
+		<< " ended early at an instruction that would reach outside memory or the keypad, or that the core ignores." << std::endl;
+	return 0;
+}
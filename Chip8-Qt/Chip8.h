@@ -3,12 +3,15 @@
 #include <QObject>
 
 #include <array>
-#include <chrono>
 #include <cstdint>
 #include <ctime>
-#include <random>
-#include <stack>
 #include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4324)	// Padded out to whole cache lines on purpose, see registers
+#endif
 
 class Chip8
 {
@@ -18,30 +21,232 @@ public:
 	static constexpr int DISPLAY_HEIGHT{ 32 };
 	static constexpr std::uint8_t KEY_COUNT{ 16 };	// Number of input keys
 	static constexpr std::size_t MEMORY_SIZE{ 4096 };
+	static constexpr std::size_t MAX_ROM_SIZE{ MEMORY_SIZE - 0x200 };	// ROMs are loaded at MEM_START
+	static constexpr std::size_t STACK_SIZE{ 16 };
+	static constexpr int DELAY_TIMER_HZ{ 60 };
+	static constexpr std::uint32_t DEFAULT_INSTRUCTIONS_PER_FRAME{ 10 };	// Instructions per 60Hz timer tick
 
 	using keypad_type = std::array<std::uint8_t, KEY_COUNT>;
 	using memory_type = std::array<std::uint8_t, MEMORY_SIZE>;
-	using display_type = std::array<std::uint32_t, DISPLAY_WIDTH * DISPLAY_HEIGHT>;
+	using display_type = std::array<std::uint32_t, DISPLAY_WIDTH * DISPLAY_HEIGHT>;	// One RGBA value per pixel
+	using framebuffer_type = std::array<std::uint64_t, DISPLAY_HEIGHT>;				// One bit per pixel, bit 63 is column 0
+
+	// Instruction decode strategy used by cycle()
+	enum class Dispatch
+	{
+		Switch,	// Nested switch on opcode nibbles (reference)
+		Table,	// Compile-time table indexed by the full opcode
+		Cached	// Table decode, kept per ROM address until that memory is written
+	};
+
+	// Systems whose instructions differ in BNNN, 8XY6/8XYE and FX55/FX65, each run by its own instantiation of the core
+	enum class Platform
+	{
+		CosmacVip,
+		SuperChip,
+		XoChip
+	};
+
+	// Outcome of one runFrame() call
+	struct FrameResult
+	{
+		bool displayChanged{ false };	// DXYN or 00E0 changed a row during the frame
+		bool soundActive{ false };		// Sound timer still running when the frame ended
+		bool waitingForKey{ false };	// Stopped on FX0A with no key held
+		bool timersRunning{ false };	// Delay or sound timer will tick next frame
+	};
+
+	// PCG32 (XSH RR): 16 bytes of state, and each stream is an independent sequence for the same seed
+	class Rng
+	{
+	public:
+		Rng()
+		{
+			seed(0);
+		}
+
+		explicit Rng(std::uint64_t value, std::uint64_t stream = 0)
+		{
+			seed(value, stream);
+		}
+
+		void seed(std::uint64_t value, std::uint64_t stream = 0)
+		{
+			state = 0;
+			increment = (stream << 1) | 1;
+			next();
+			state += value;
+			next();
+		}
+
+		std::uint32_t next()
+		{
+			std::uint64_t old{ state };
+			state = old * 6364136223846793005ULL + increment;
+			std::uint32_t xorShifted{ static_cast<std::uint32_t>(((old >> 18) ^ old) >> 27) };
+			std::uint32_t rotation{ static_cast<std::uint32_t>(old >> 59) };
+			return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+		}
+
+		// A random byte, from the generator's best bits
+		std::uint8_t nextByte()
+		{
+			return static_cast<std::uint8_t>(next() >> 24);
+		}
+
+		bool operator==(const Rng& other) const
+		{
+			return state == other.state && increment == other.increment;
+		}
+
+		bool operator!=(const Rng& other) const
+		{
+			return !(*this == other);
+		}
+
+	private:
+		std::uint64_t state{};
+		std::uint64_t increment{};	// Always odd, selects the stream
+	};
+
+	// Everything a running ROM can change, along with the platform and clock it runs with.
+	// Trivially copyable, so taking or restoring one is a single copy with no allocation.
+	struct State
+	{
+		memory_type memory{};
+		framebuffer_type display{};
+		std::array<std::uint8_t, 16> registers{};
+		std::array<std::uint16_t, STACK_SIZE> stack{};
+		std::uint8_t sp{};
+		bool stackFaulted{};
+		std::uint16_t ir{};
+		std::uint16_t pc{};
+		std::uint8_t delayTimer{};
+		std::uint8_t soundTimer{};
+		std::uint32_t instructionsPerFrame{};
+		std::uint32_t frameInstructions{};
+		std::uint64_t instructionCount{};
+		keypad_type keypad{};
+		bool waitingForKey{};
+		bool displayWait{};
+		Platform platform{};
+		Rng rng{};
+	};
 
 	Chip8();
 	bool loadRom(const std::string& filename);
+	bool loadRom(const std::vector<std::uint8_t>& rom);	// Quietly, and without changing the platform
 	bool cycle();
+	bool run(std::size_t instructions);
+
+	// Run up to the next 60Hz timer tick, at most getInstructionsPerFrame() instructions
+	FrameResult runFrame();
+
+	void setDispatch(Dispatch mode);
+
+	// The timers tick once every this many instructions rather than by wall clock, so runs are reproducible
+	void setInstructionsPerFrame(std::uint32_t instructions);
+	std::uint32_t getInstructionsPerFrame() const;
+
+	// COSMAC VIP quirk: DXYN waits for the vertical blank, so it ends the frame in runFrame()
+	void setDisplayWait(bool enabled);
+	bool getDisplayWait() const;
+
+	// CXNN draws from a time-seeded generator, a fixed seed makes a run repeatable.
+	// Machines given the same seed on different streams draw unrelated numbers.
+	void seedRng(std::uint32_t seed, std::uint32_t stream = 0);
+
+	// Instructions executed since reset, including ones skipped by idle loop fast-forwarding
+	std::uint64_t getInstructionCount() const
+	{
+		return instructionCount;
+	}
+
+	// Snapshot the machine, e.g. for tree search. Restoring marks every row dirty and drops decoded instructions,
+	// but a Chip8Jit driving this machine must still be flushed.
+	State fork() const;
+	void restore(const State& state);
+
+	// Save states: fork() in a compact, versioned binary format, with the display kept at one bit per pixel.
+	// Loading checks the format and version, then restores everything but the decode strategy.
+	std::vector<std::uint8_t> saveState() const;
+	bool saveState(const std::string& filename) const;
+	bool loadState(const std::vector<std::uint8_t>& data);
+	bool loadState(const std::string& filename);
+
+	void setPlatform(Platform platform);
+	Platform getPlatform() const;
+
+	// Guess the platform from the ROM's file extension, loadRom() applies this automatically
+	static Platform platformForRom(const std::string& filename);
 
 	keypad_type& getKeypad()
 	{
 		return keypad;
 	}
 
-	display_type& getDisplay()
+	const keypad_type& getKeypad() const
+	{
+		return keypad;
+	}
+
+	const memory_type& getMemory() const
+	{
+		return memory;
+	}
+
+	// A 2NNN found all STACK_SIZE entries in use and dropped the oldest,
+	// or a 00EE found none and stopped the ROM on that instruction
+	bool isStackFaulted() const
+	{
+		return stackFaulted;
+	}
+
+	// FX0A found no key held, nothing but the timers will change until one is
+	bool isWaitingForKey() const
+	{
+		return waitingForKey;
+	}
+
+	const framebuffer_type& getFramebuffer() const
 	{
 		return display;
 	}
 
+	// Expand the framebuffer for rendering, lit pixels are 0xFFFFFFFF
+	display_type getDisplay() const;
+
+	// Bit n is set when row n of the framebuffer has changed since the last clearDirtyRows()
+	std::uint32_t getDirtyRows() const
+	{
+		return dirtyRows;
+	}
+
+	bool displayChanged() const
+	{
+		return dirtyRows != 0;
+	}
+
+	void clearDirtyRows()
+	{
+		dirtyRows = 0;
+	}
+
 private:
+	friend class Chip8Jit;
+	friend class Chip8Aot;
+	friend class Chip8AotCompiler;
+	friend class Chip8Simd;
+	friend class Disassembler;
+	friend class Microbenchmarks;
+#if defined(CHIP8_PROFILE)
+	friend class Profiler;
+#endif
+
 	static constexpr std::size_t MEM_START{ 0x200 };		// Starting point for ROM memory
 	static constexpr std::size_t FONTCHARS_LENGTH{ 80 };	// Each char 5 bytes, 5 * 16 chars = 80 bytes
 	static constexpr std::uint8_t FONTCHAR_START{ 0x50 };	// Starting point for font memory
-	static constexpr int DELAY_TIMER_HZ{ 60 };
+	static constexpr std::uint32_t ALL_ROWS_DIRTY{ 0xFFFFFFFF };
 
 	static constexpr std::uint16_t BITMASK_X{ 0x0F00 };
 	static constexpr std::uint16_t BITMASK_Y{ 0x00F0 };
@@ -49,27 +254,122 @@ private:
 	static constexpr std::uint16_t BITMASK_NN{ 0x00FF };
 	static constexpr std::uint16_t BITMASK_NNN{ 0x0FFF };
 
-	std::mt19937 rngEngine{ static_cast<std::mt19937::result_type>(std::time(nullptr)) };
-	std::uniform_int_distribution<> intRng{ 0, 0xFF };
+	// Index into handlerTable for each instruction, in decode order
+	enum class Op : std::uint8_t
+	{
+		NOP,
+		OP_00E0, OP_00EE, OP_1NNN, OP_2NNN, OP_3XNN, OP_4XNN, OP_5XY0, OP_6XNN, OP_7XNN,
+		OP_8XY0, OP_8XY1, OP_8XY2, OP_8XY3, OP_8XY4, OP_8XY5, OP_8XY6, OP_8XY7, OP_8XYE,
+		OP_9XY0, OP_ANNN, OP_BNNN, OP_CXNN, OP_DXYN, OP_EX9E, OP_EXA1,
+		OP_FX07, OP_FX0A, OP_FX15, OP_FX18, OP_FX1E, OP_FX29, OP_FX33, OP_FX55, OP_FX65,
+		COUNT
+	};
 
-	memory_type memory{};						// 4kB 8-bit main memory
-	std::array<std::uint8_t, 16> registers{};	// 16 8-bit registers
+	// Opcode with its operands already extracted
+	struct Instruction
+	{
+		std::uint16_t opcode{};
+		std::uint16_t nnn{};
+		std::uint8_t nn{};
+		std::uint8_t n{};
+		std::uint8_t x{};
+		std::uint8_t y{};
+		Op op{ Op::NOP };
+		bool cached{ false };	// Entry in decodeCache is up to date
+	};
 
-	std::uint16_t ir{};						// 16-bit index register
-	std::uint16_t pc{};						// 16-bit program counter
-	std::uint16_t opcode{};					// 16-bit opcode	
+#if defined(CHIP8_PROFILE)
+	// What the interpreter has run since the machine was created, exported by Profiler. Only builds with CHIP8_PROFILE
+	// defined count anything, and only in cycle(), run() and runFrame(). Blocks compiled by Chip8Jit and Chip8Aot, and
+	// Chip8Simd lanes, are missed.
+	struct ExecutionProfile
+	{
+		std::array<std::uint64_t, static_cast<std::size_t>(Op::COUNT)> handlers{};	// Indexed by Op
+		std::array<std::uint64_t, MEMORY_SIZE> addresses{};	// Instructions fetched from each address
+		std::uint64_t pixelsDrawn{};			// Sprite pixels DXYN drew, after clipping
+		std::uint64_t pixelsErased{};			// Of those, the ones that turned a lit pixel off
+		std::uint64_t collisions{};				// DXYNs that set VF
+		std::uint64_t keyWaitInstructions{};	// Instructions spent in FX0A with no key held
+		std::uint64_t fastForwarded{};			// Instructions run() counted without fetching them
+	};
+#endif
 
-	std::stack<std::uint16_t> stack{};		// 16-bit address stack
+	// Decoded instructions for 0x200-0xFFE, indexed by (address - MEM_START)
+	static constexpr std::size_t DECODE_CACHE_SIZE{ MEMORY_SIZE - MEM_START - 1 };
 
-	std::chrono::steady_clock::time_point delayLastTick{ std::chrono::high_resolution_clock::now() };
+	using handler_type = void (Chip8::*)(const Instruction&);
+	using handler_table_type = std::array<handler_type, static_cast<std::size_t>(Op::COUNT)>;
+
+	// Quirk policies, see Platform
+	struct VipQuirks
+	{
+		static constexpr bool jumpOffsetUsesX{ false };			// BNNN jumps to NNN + V0
+		static constexpr bool shiftUsesY{ true };				// 8XY6/8XYE shift VY into VX
+		static constexpr bool loadStoreIncrementsIr{ true };	// FX55/FX65 leave I past the last register
+	};
+
+	struct SuperChipQuirks
+	{
+		static constexpr bool jumpOffsetUsesX{ true };			// BXNN jumps to XNN + VX
+		static constexpr bool shiftUsesY{ false };				// 8XY6/8XYE shift VX in place
+		static constexpr bool loadStoreIncrementsIr{ false };	// FX55/FX65 leave I unchanged
+	};
+
+	struct XoChipQuirks
+	{
+		static constexpr bool jumpOffsetUsesX{ false };
+		static constexpr bool shiftUsesY{ true };
+		static constexpr bool loadStoreIncrementsIr{ true };
+	};
+
+	// Entry points of the core instantiated for one quirk policy
+	struct Profile
+	{
+		Platform platform;
+		bool jumpOffsetUsesX;		// Quirk values, for the recompilers
+		bool shiftUsesY;
+		bool loadStoreIncrementsIr;
+		const handler_table_type* handlers;
+		bool (Chip8::*dispatchSwitch)(const Instruction&);
+		bool (Chip8::*run)(std::size_t);
+	};
+
+	template<typename Quirks>
+	static const handler_table_type handlerTable;
+
+	template<typename Quirks>
+	static constexpr Profile makeProfile(Platform platform);
+
+	static const std::array<Profile, 3> profiles;	// Indexed by Platform
+	static const std::array<Op, 0x10000> decodeTable;
+
+	static constexpr Op decode(std::uint16_t opcode);
+
+	// Touched by nearly every instruction, kept together on one cache line
+	alignas(64) std::array<std::uint8_t, 16> registers{};	// 16 8-bit registers
+	std::uint16_t ir{};						// 16-bit index register
+	std::uint16_t pc{};						// 16-bit program counter
+	std::uint8_t sp{};						// Next free stack entry
 	std::uint8_t delayTimer{};				// 8-bit delay timer
 	std::uint8_t soundTimer{};				// 8-bit sound timer
+	bool waitingForKey{ false };			// Last FX0A found no key held and will run again
+	std::uint32_t frameInstructions{};		// Instructions since the timers last ticked
+	std::uint32_t instructionsPerFrame{ DEFAULT_INSTRUCTIONS_PER_FRAME };
+	std::uint32_t dirtyRows{ ALL_ROWS_DIRTY };	// Rows changed by DXYN/00E0, everything needs drawing at first
+	bool endFrameOnDraw{ false };			// Set while runFrame() is honouring displayWait
+	bool displayWait{ false };
+	bool stackFaulted{ false };
+	std::uint64_t instructionCount{};
+	const Profile* profile{ &profiles[static_cast<std::size_t>(Platform::SuperChip)] };
+	Dispatch dispatch{ Dispatch::Switch };	// Read by every cycle()
 
+	std::array<std::uint16_t, STACK_SIZE> stack{};	// 16-bit address stack
 	keypad_type keypad{};					// Input keypad (Hex 0-F)
 
-	display_type display{};					// 64px * 32px display
+	memory_type memory{};					// 4kB 8-bit main memory
+	framebuffer_type display{};				// 64px * 32px display
 
-	std::array<std::uint8_t, FONTCHARS_LENGTH> fontChars
+	static constexpr std::array<std::uint8_t, FONTCHARS_LENGTH> FONTCHARS
 	{
 		0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
 		0x20, 0x60, 0x20, 0x20, 0x70, // 1
@@ -89,45 +389,72 @@ private:
 		0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 	};
 
-	bool altJumpOffset{ true };	// Alt inst. flag for BNNN
-	bool altShrShl{ false };	// Alt inst. flag for 8XY6, 8XYE
-	bool altLoadStore{ false };	// Alt inst. flag for FX55, FX65
+	std::vector<Instruction> decodeCache{};	// Only allocated for Dispatch::Cached
+
+	Rng rng{ static_cast<std::uint64_t>(std::time(nullptr)) };
+
+#if defined(CHIP8_PROFILE)
+	ExecutionProfile executionProfile{};
+	void profileInstruction();
+	void profileKeyWait(std::size_t skipped);
+#endif
 
 	void reset();
+	void tickTimers(std::size_t instructions);
+	void faultStack(const char* error);
 	std::uint16_t fetch();
+	static Instruction decodeOperands(std::uint16_t opcode);
+	static Instruction decodeInstruction(std::uint16_t opcode);
+	Instruction fetchCached();
+	void invalidateDecoded(std::size_t address, std::size_t length);
+	template<typename Quirks>
+	bool dispatchSwitch(const Instruction& inst);
+	template<typename Quirks>
+	bool runWith(std::size_t instructions);
 
-	void opcode_00E0();
-	void opcode_00EE();
-	void opcode_1NNN();
-	void opcode_2NNN();
-	void opcode_3XNN();
-	void opcode_4XNN();
-	void opcode_5XY0();
-	void opcode_6XNN();
-	void opcode_7XNN();
-	void opcode_8XY0();
-	void opcode_8XY1();
-	void opcode_8XY2();
-	void opcode_8XY3();
-	void opcode_8XY4();
-	void opcode_8XY5();
-	void opcode_8XY6();
-	void opcode_8XY7();
-	void opcode_8XYE();
-	void opcode_9XY0();
-	void opcode_ANNN();
-	void opcode_BNNN();
-	void opcode_CXNN();
-	void opcode_DXYN();
-	void opcode_EX9E();
-	void opcode_EXA1();
-	void opcode_FX07();
-	void opcode_FX0A();
-	void opcode_FX15();
-	void opcode_FX18();
-	void opcode_FX1E();
-	void opcode_FX29();
-	void opcode_FX33();
-	void opcode_FX55();
-	void opcode_FX65();
+	void opcode_NOP(const Instruction& inst);
+
+	void opcode_00E0(const Instruction& inst);
+	void opcode_00EE(const Instruction& inst);
+	void opcode_1NNN(const Instruction& inst);
+	void opcode_2NNN(const Instruction& inst);
+	void opcode_3XNN(const Instruction& inst);
+	void opcode_4XNN(const Instruction& inst);
+	void opcode_5XY0(const Instruction& inst);
+	void opcode_6XNN(const Instruction& inst);
+	void opcode_7XNN(const Instruction& inst);
+	void opcode_8XY0(const Instruction& inst);
+	void opcode_8XY1(const Instruction& inst);
+	void opcode_8XY2(const Instruction& inst);
+	void opcode_8XY3(const Instruction& inst);
+	void opcode_8XY4(const Instruction& inst);
+	void opcode_8XY5(const Instruction& inst);
+	template<typename Quirks>
+	void opcode_8XY6(const Instruction& inst);
+	void opcode_8XY7(const Instruction& inst);
+	template<typename Quirks>
+	void opcode_8XYE(const Instruction& inst);
+	void opcode_9XY0(const Instruction& inst);
+	void opcode_ANNN(const Instruction& inst);
+	template<typename Quirks>
+	void opcode_BNNN(const Instruction& inst);
+	void opcode_CXNN(const Instruction& inst);
+	void opcode_DXYN(const Instruction& inst);
+	void opcode_EX9E(const Instruction& inst);
+	void opcode_EXA1(const Instruction& inst);
+	void opcode_FX07(const Instruction& inst);
+	void opcode_FX0A(const Instruction& inst);
+	void opcode_FX15(const Instruction& inst);
+	void opcode_FX18(const Instruction& inst);
+	void opcode_FX1E(const Instruction& inst);
+	void opcode_FX29(const Instruction& inst);
+	void opcode_FX33(const Instruction& inst);
+	template<typename Quirks>
+	void opcode_FX55(const Instruction& inst);
+	template<typename Quirks>
+	void opcode_FX65(const Instruction& inst);
 };
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
@@ -1,17 +1,20 @@
 #include "EmuWrapper.h"
+#include "DisplayExpander.h"
 #include <QImage>
 
 EmuWrapper::EmuWrapper()
 {
-	originalScreen = QImage(Chip8::DISPLAY_WIDTH, Chip8::DISPLAY_HEIGHT, QImage::Format_RGBA8888);
+	constexpr int pitch{ sizeof(Chip8::display_type::value_type) * Chip8::DISPLAY_WIDTH };
+	originalScreen = QImage(reinterpret_cast<const uchar*>(pixels.data()), Chip8::DISPLAY_WIDTH, Chip8::DISPLAY_HEIGHT, pitch,
+		QImage::Format_RGBA8888);
 }
 
 void EmuWrapper::run()
 {
 	constexpr int INSTRUCTIONS_PER_SECOND{ 400 };
-	const int cyclesPerFrame{ INSTRUCTIONS_PER_SECOND / 60 };
+	const int cyclesPerFrame{ INSTRUCTIONS_PER_SECOND / Chip8::DELAY_TIMER_HZ };
 
-	restartEmu();
+	emu.setInstructionsPerFrame(cyclesPerFrame);
 
 	//auto t_start = std::chrono::high_resolution_clock::now();
 
@@ -22,20 +25,60 @@ void EmuWrapper::run()
 		//auto t_end = std::chrono::high_resolution_clock::now();
 		//double elapsed_time_ms = std::chrono::duration<double, std::milli>(t_end - t_start).count();
 
-		for (int i{ 0 }; i < cyclesPerFrame; i++)
+		bool stepBack{};
 		{
-			emu.cycle();
+			std::lock_guard<std::mutex> lock{ inputMutex };
+			inputPending = false;
+			stepBack = rewinding;
 		}
+
+		applyStateRequests();
+		if (stepBack)
+		{
+			Chip8::keypad_type held{ emu.getKeypad() };
+			rewind.stepBack(emu);
+			emu.getKeypad() = held;
+			showFramebuffer();
+			usleep(1000000 / Chip8::DELAY_TIMER_HZ);
+			continue;
+		}
+
+		Chip8::FrameResult frame{ emu.runFrame() };
+		rewind.push(emu);
 		showFramebuffer();
-		usleep(1000.0/60.0);
+
+		// Waiting on FX0A with both timers stopped, park the thread until the next key event
+		if (frame.waitingForKey && !frame.timersRunning)
+		{
+			std::unique_lock<std::mutex> lock{ inputMutex };
+			inputEvent.wait(lock, [this]() { return inputPending; });
+		}
+
+		usleep(1000000 / Chip8::DELAY_TIMER_HZ);
 	}
 }
 
 void EmuWrapper::showFramebuffer()
 {
-	Chip8::display_type display{ emu.getDisplay() };
-	auto displayChar{ reinterpret_cast<uchar*>(display.data())};
-	originalScreen = QImage(displayChar, Chip8::DISPLAY_WIDTH, Chip8::DISPLAY_HEIGHT, QImage::Format_RGBA8888);
+	std::uint32_t dirtyRows{ emu.getDirtyRows() };
+	if (dirtyRows == 0) return;
+	emu.clearDirtyRows();
+
+	// Only expand the runs of rows that changed, pixels keeps the rest from the last frame
+	const Chip8::framebuffer_type& framebuffer{ emu.getFramebuffer() };
+	int row{ 0 };
+	while (row < Chip8::DISPLAY_HEIGHT)
+	{
+		if (!(dirtyRows & (std::uint32_t{ 1 } << row)))
+		{
+			++row;
+			continue;
+		}
+
+		int firstRow{ row };
+		while (row < Chip8::DISPLAY_HEIGHT && (dirtyRows & (std::uint32_t{ 1 } << row))) ++row;
+		DisplayExpander::expandRows(framebuffer, pixels, firstRow, row - firstRow);
+	}
 
 	transformedScreen = originalScreen.scaled(640, 320);
 	emit screenUpdated(transformedScreen);
@@ -64,19 +107,98 @@ void EmuWrapper::handleInput(const int key, bool pressed)
 	case Qt::Key_C: keypad[0xB] = pressed; break;
 	case Qt::Key_V: keypad[0xF] = pressed; break;
 	}
+
+	notifyInput();
 }
 
 void EmuWrapper::openFile(const std::string& filename)
 {
-	if (!filename.empty())
+	if (filename.empty()) return;
+
 	{
-		romFile = filename;
-		restartEmu();
+		std::lock_guard<std::mutex> lock{ inputMutex };
+		openRomFile = filename;
 	}
+	notifyInput();
 }
 
 void EmuWrapper::restartEmu()
 {
-	emu.loadRom(romFile);
-	showFramebuffer();
+	{
+		std::lock_guard<std::mutex> lock{ inputMutex };
+		restartRequested = true;
+	}
+	notifyInput();
+}
+
+void EmuWrapper::saveState(const std::string& filename)
+{
+	{
+		std::lock_guard<std::mutex> lock{ inputMutex };
+		saveStateFile = filename;
+	}
+	notifyInput();
+}
+
+void EmuWrapper::setRewinding(bool held)
+{
+	{
+		std::lock_guard<std::mutex> lock{ inputMutex };
+		rewinding = held;
+	}
+	notifyInput();
+}
+
+void EmuWrapper::loadState(const std::string& filename)
+{
+	{
+		std::lock_guard<std::mutex> lock{ inputMutex };
+		loadStateFile = filename;
+	}
+	notifyInput();
+}
+
+// Runs on the emulator thread, so a ROM is never loaded, or a state taken or restored, part way through a frame
+void EmuWrapper::applyStateRequests()
+{
+	std::string romRequest{};
+	bool restart{};
+	std::string saveFile{};
+	std::string loadFile{};
+	{
+		std::lock_guard<std::mutex> lock{ inputMutex };
+		romRequest.swap(openRomFile);
+		restart = restartRequested;
+		restartRequested = false;
+		saveFile.swap(saveStateFile);
+		loadFile.swap(loadStateFile);
+	}
+
+	if (!romRequest.empty()) romFile = romRequest;
+	if (!romRequest.empty() || restart)
+	{
+		// Rewinding can't go back past the start of the ROM
+		emu.loadRom(romFile);
+		rewind.clear();
+		rewind.push(emu);
+		showFramebuffer();
+	}
+
+	if (!saveFile.empty()) emu.saveState(saveFile);
+	if (!loadFile.empty())
+	{
+		// Keep the keys that are physically held, not the ones held when the state was saved
+		Chip8::keypad_type held{ emu.getKeypad() };
+		if (emu.loadState(loadFile)) emu.getKeypad() = held;
+		showFramebuffer();
+	}
+}
+
+void EmuWrapper::notifyInput()
+{
+	{
+		std::lock_guard<std::mutex> lock{ inputMutex };
+		inputPending = true;
+	}
+	inputEvent.notify_one();
 }
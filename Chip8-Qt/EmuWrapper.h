@@ -3,7 +3,11 @@
 #include <QThread>
 #include <QImage>
 
+#include <condition_variable>
+#include <mutex>
+
 #include "Chip8.h"
+#include "RewindBuffer.h"
 
 class EmuWrapper : public QThread
 {
@@ -13,14 +17,27 @@ public:
 	EmuWrapper();
 
 private:
+	Chip8::display_type pixels{};	// Expanded framebuffer, originalScreen draws straight from it
 	QImage originalScreen;
 	QImage transformedScreen;
 	Chip8 emu{};
-	std::string romFile{};
+	std::string romFile{};			// Only touched by run()
+
+	std::mutex inputMutex{};
+	std::condition_variable inputEvent{};
+	bool inputPending{ false };		// A slot ran since the last frame, wakes run() from a key wait
+	std::string openRomFile{};		// ROM, restart, save or load requested by a slot, done by run() between frames
+	bool restartRequested{ false };
+	std::string saveStateFile{};
+	std::string loadStateFile{};
+	bool rewinding{ false };		// Rewind key held, run() steps back instead of forward
+	RewindBuffer rewind{};			// Only touched by run()
 
 private:
 	void run();
 	void showFramebuffer();
+	void notifyInput();
+	void applyStateRequests();
 
 signals:
 	void screenUpdated(QImage const&);
@@ -30,5 +47,8 @@ public slots:
 	void handleInput(const int, bool);
 	void openFile(std::string const&);
 	void restartEmu();
+	void saveState(std::string const&);
+	void loadState(std::string const&);
+	void setRewinding(bool);
 };
 
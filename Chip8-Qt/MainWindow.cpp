@@ -11,9 +11,14 @@ MainWindow::MainWindow(QWidget *parent)
     connect(&emu, SIGNAL(screenUpdated(QImage const&)), this, SLOT(showScreen(QImage const&)));
     connect(ui.actionOpen_ROM, SIGNAL(triggered()), this, SLOT(menuOpenROM()));
     connect(ui.actionReset_Emulator, SIGNAL(triggered()), this, SLOT(menuResetEmu()));
+    connect(ui.actionSave_State, SIGNAL(triggered()), this, SLOT(menuSaveState()));
+    connect(ui.actionLoad_State, SIGNAL(triggered()), this, SLOT(menuLoadState()));
     connect(this, SIGNAL(inputReceived(const int, bool)), &emu, SLOT(handleInput(const int, bool)));
     connect(this, SIGNAL(runFile(std::string const&)), &emu, SLOT(openFile(std::string const&)));
     connect(this, SIGNAL(resetEmu()), &emu, SLOT(restartEmu()));
+    connect(this, SIGNAL(saveStateFile(std::string const&)), &emu, SLOT(saveState(std::string const&)));
+    connect(this, SIGNAL(loadStateFile(std::string const&)), &emu, SLOT(loadState(std::string const&)));
+    connect(this, SIGNAL(rewindHeld(bool)), &emu, SLOT(setRewinding(bool)));
 }
 
 void MainWindow::menuOpenROM()
@@ -29,6 +34,23 @@ void MainWindow::menuResetEmu()
     emit(resetEmu());
 }
 
+void MainWindow::menuSaveState()
+{
+    if (!emu.isRunning()) return;
+
+    auto fileName{ QFileDialog::getSaveFileName(this, "Save Chip8 state", QString(), "Save states (*.state)") };
+    if (!fileName.isNull()) emit(saveStateFile(fileName.toStdString()));
+}
+
+void MainWindow::menuLoadState()
+{
+    auto fileName{ QFileDialog::getOpenFileName(this, "Load Chip8 state", QString(), "Save states (*.state)") };
+    if (fileName.isNull()) return;
+
+    emit(loadStateFile(fileName.toStdString()));
+    if (!emu.isRunning()) emu.start();
+}
+
 void MainWindow::showScreen(QImage const& image)
 {
     ui.label->setPixmap(QPixmap::fromImage(image));
@@ -47,6 +69,11 @@ void MainWindow::keyPressEvent(QKeyEvent* event)
     {
         event->ignore();
     }
+    else if (event->key() == Qt::Key_Backspace)
+    {
+        // Rewinds one frame per frame for as long as it is held
+        emit rewindHeld(true);
+    }
     else
     {
         emit inputReceived(event->key(), true);
@@ -60,6 +87,10 @@ void MainWindow::keyReleaseEvent(QKeyEvent* event)
     {
         event->ignore();
     }
+    else if (event->key() == Qt::Key_Backspace)
+    {
+        emit rewindHeld(false);
+    }
     else
     {
         emit inputReceived(event->key(), false);
@@ -24,6 +24,8 @@ private:
 public slots:
     void menuOpenROM();
     void menuResetEmu();
+    void menuSaveState();
+    void menuLoadState();
     void showScreen(QImage const&);
     void closeEvent(QCloseEvent*);
 
@@ -31,4 +33,7 @@ signals:
     void inputReceived(const int, bool);
     void runFile(std::string const&);
     void resetEmu();
+    void saveStateFile(std::string const&);
+    void loadStateFile(std::string const&);
+    void rewindHeld(bool);
 };
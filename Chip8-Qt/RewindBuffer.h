@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Chip8.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// History of recent frames for stepping a Chip8 backwards.
+// Each frame is stored as the XOR of its state with the frame before, run-length encoded, so a frame costs only the
+// few bytes that changed. XOR undoes itself, so stepping back applies the newest delta to the newest state.
+// Entries live in a fixed-size byte ring, and the oldest are dropped once it fills.
+class RewindBuffer
+{
+public:
+	static constexpr std::size_t DEFAULT_CAPACITY{ 4 * 1024 * 1024 };	// Bytes of history
+
+	explicit RewindBuffer(std::size_t capacity = DEFAULT_CAPACITY);
+
+	// Record chip8 as the newest frame, e.g. after every runFrame()
+	void push(const Chip8& chip8);
+
+	// Restore chip8 to the frame recorded before the newest one, which then becomes the newest.
+	// False when no older frame is left.
+	bool stepBack(Chip8& chip8);
+
+	void clear();
+
+	// Frames stepBack() can still go back
+	std::size_t frames() const
+	{
+		return entryCount;
+	}
+
+	std::size_t bytesUsed() const
+	{
+		return used;
+	}
+
+private:
+	using snapshot_type = std::array<std::uint8_t, sizeof(Chip8::State)>;
+
+	static constexpr std::size_t LENGTH_BYTES{ 4 };	// Entry length, stored before and after each entry
+
+	std::vector<std::uint8_t> ring{};
+	std::size_t head{};			// Start of the oldest entry
+	std::size_t used{};
+	std::size_t entryCount{};
+
+	snapshot_type newest{};		// State of the newest frame, the deltas chain back from it
+	bool hasNewest{ false };
+	snapshot_type current{};
+	std::vector<std::uint8_t> delta{};	// Scratch for one encoded entry, sized for the worst case up front
+
+	static void toBytes(const Chip8::State& state, snapshot_type& bytes);
+	std::size_t encode(const snapshot_type& from, const snapshot_type& to);
+	void decode(std::size_t length, snapshot_type& bytes) const;
+
+	void write(std::size_t offset, const std::uint8_t* data, std::size_t length);
+	void read(std::size_t offset, std::uint8_t* data, std::size_t length) const;
+	std::uint32_t readLength(std::size_t offset) const;
+	void dropOldest();
+};
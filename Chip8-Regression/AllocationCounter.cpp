@@ -0,0 +1,66 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+namespace
+{
+	std::atomic<std::uint64_t> allocations{ 0 };
+}
+
+std::uint64_t AllocationCounter::count()
+{
+	return allocations.load(std::memory_order_relaxed);
+}
+
+// The library's array and nothrow forms forward to these
+void* operator new(std::size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* memory{ std::malloc(size ? size : 1) }) return memory;
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	operator delete(memory);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	std::size_t align{ static_cast<std::size_t>(alignment) };
+	std::size_t bytes{ size ? size : 1 };
+#if defined(_MSC_VER)
+	void* memory{ _aligned_malloc(bytes, align) };
+#else
+	// aligned_alloc only takes whole multiples of the alignment
+	void* memory{ std::aligned_alloc(align, (bytes + align - 1) / align * align) };
+#endif
+	if (memory) return memory;
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+#if defined(_MSC_VER)
+	_aligned_free(memory);
+#else
+	std::free(memory);
+#endif
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(memory, alignment);
+}
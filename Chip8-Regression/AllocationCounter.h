@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts calls to the global operator new, which AllocationCounter.cpp replaces for the whole harness, so the suite
+// can check that the core doesn't allocate once a ROM is running
+class AllocationCounter
+{
+public:
+	// Allocations made by any thread since the program started
+	static std::uint64_t count();
+};
@@ -0,0 +1,105 @@
+#include "RegressionSuite.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[])
+{
+	bool update{ false };
+	std::string performancePath{};
+	std::string baselinePath{};
+#if defined(CHIP8_PROFILE)
+	std::string profileDirectory{};
+#endif
+	double tolerance{ 0.2 };
+	double minimumMs{ 200.0 };
+
+	int arg{ 1 };
+	for (; arg < argc && std::string{ argv[arg] }.rfind("--", 0) == 0; ++arg)
+	{
+		const std::string option{ argv[arg] };
+		bool hasValue{ arg + 1 < argc };
+		if (option == "--update")
+		{
+			update = true;
+		}
+		else if (option == "--perf" && hasValue)
+		{
+			performancePath = argv[++arg];
+		}
+		else if (option == "--baseline" && hasValue)
+		{
+			baselinePath = argv[++arg];
+		}
+		else if (option == "--tolerance" && hasValue)
+		{
+			tolerance = std::stod(argv[++arg]);
+		}
+		else if (option == "--min-ms" && hasValue)
+		{
+			minimumMs = std::stod(argv[++arg]);
+		}
+		else if (option == "--profile" && hasValue)
+		{
+#if defined(CHIP8_PROFILE)
+			profileDirectory = argv[++arg];
+#else
+			std::cout << "--profile needs a build with CHIP8_PROFILE defined" << std::endl;
+			return 1;
+#endif
+		}
+		else
+		{
+			std::cout << "Unknown option " << option << std::endl;
+			return 1;
+		}
+	}
+
+	if (argc - arg < 2)
+	{
+		std::cout << "Usage: Chip8-Regression [--update] [--perf <results.csv> [--baseline <results.csv>] [--tolerance <fraction>] "
+			"[--min-ms <ms>]] [--profile <directory>] <suite> <golden>" << std::endl;
+		return 1;
+	}
+
+	std::string suitePath{ argv[arg] };
+	std::string goldenPath{ argv[arg + 1] };
+
+	RegressionSuite suite{};
+	if (!suite.loadSuite(suitePath)) return 1;
+	if (!update && !suite.loadGolden(goldenPath)) return 1;
+
+	bool passed{ suite.check(update) };
+	if (!update && !suite.checkAllocations()) passed = false;
+	if (update)
+	{
+		if (!suite.saveGolden(goldenPath)) return 1;
+		std::cout << "Recorded golden checkpoints for " << suite.caseCount() << " cases in " << goldenPath << std::endl;
+	}
+
+	if (!performancePath.empty())
+	{
+		suite.measure(minimumMs);
+
+		std::ofstream results{ performancePath };
+		if (!results)
+		{
+			std::cout << "Failed to open " << performancePath << std::endl;
+			return 1;
+		}
+		suite.writePerformance(results);
+
+		if (!baselinePath.empty() && !suite.compareBaseline(baselinePath, tolerance)) passed = false;
+	}
+
+#if defined(CHIP8_PROFILE)
+	if (!profileDirectory.empty())
+	{
+		if (!suite.writeProfiles(profileDirectory)) return 1;
+		std::cout << "Wrote profiles for " << suite.caseCount() << " cases to " << profileDirectory << std::endl;
+	}
+#endif
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,427 @@
+#include "RegressionSuite.h"
+#include "AllocationCounter.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <utility>
+
+namespace
+{
+	// Dispatch::Switch first, every other mode is checked against it
+	constexpr Chip8::Dispatch DISPATCH_MODES[]{ Chip8::Dispatch::Switch, Chip8::Dispatch::Table, Chip8::Dispatch::Cached };
+}
+
+bool RegressionSuite::loadSuite(const std::string& filename)
+{
+	std::ifstream suiteFile{ filename };
+	if (!suiteFile)
+	{
+		std::cout << "Failed to open " << filename << std::endl;
+		return false;
+	}
+
+	std::string line{};
+	int lineNumber{ 0 };
+	while (std::getline(suiteFile, line))
+	{
+		++lineNumber;
+		if (line.empty() || line[0] == '#') continue;
+
+		RegressionCase regressionCase{};
+		std::istringstream fields{ line };
+		if (!(fields >> regressionCase.rom >> regressionCase.input >> regressionCase.seed >> regressionCase.frames
+			>> regressionCase.interval) || regressionCase.frames == 0 || regressionCase.interval == 0)
+		{
+			std::cout << filename << ':' << lineNumber << ": expected <rom> <input> <seed> <frames> <interval> [<driver>]" << std::endl;
+			return false;
+		}
+
+		std::string driver{};
+		if (fields >> driver)
+		{
+			if (driver == "run")
+			{
+				regressionCase.driver = RegressionCase::Driver::Run;
+			}
+			else if (driver != "runFrame")
+			{
+				std::cout << filename << ':' << lineNumber << ": driver must be runFrame or run" << std::endl;
+				return false;
+			}
+		}
+
+		if (!roms.count(regressionCase.rom) && !Headless::loadRom(regressionCase.rom, roms[regressionCase.rom])) return false;
+		if (regressionCase.input != "-" && !inputScripts.count(regressionCase.input)
+			&& !Headless::loadInputScript(regressionCase.input, inputScripts[regressionCase.input])) return false;
+
+		cases.push_back(regressionCase);
+	}
+
+	performance.assign(cases.size(), {});
+	return true;
+}
+
+// Each line is "<rom> <input> <seed> <frame> <framebuffer hash> <instructions>", the hash in hex
+bool RegressionSuite::loadGolden(const std::string& filename)
+{
+	std::ifstream goldenFile{ filename };
+	if (!goldenFile)
+	{
+		std::cout << "Failed to open " << filename << std::endl;
+		return false;
+	}
+
+	golden.clear();
+	std::string line{};
+	int lineNumber{ 0 };
+	while (std::getline(goldenFile, line))
+	{
+		++lineNumber;
+		if (line.empty() || line[0] == '#') continue;
+
+		RegressionCase regressionCase{};
+		Checkpoint checkpoint{};
+		std::istringstream fields{ line };
+		if (!(fields >> regressionCase.rom >> regressionCase.input >> regressionCase.seed >> checkpoint.frame
+			>> std::hex >> checkpoint.framebufferHash >> std::dec >> checkpoint.instructions))
+		{
+			std::cout << filename << ':' << lineNumber << ": expected <rom> <input> <seed> <frame> <hash> <instructions>" << std::endl;
+			return false;
+		}
+
+		golden[caseKey(regressionCase)].push_back(checkpoint);
+	}
+	return true;
+}
+
+bool RegressionSuite::saveGolden(const std::string& filename) const
+{
+	std::ofstream goldenFile{ filename };
+	if (!goldenFile)
+	{
+		std::cout << "Failed to write " << filename << std::endl;
+		return false;
+	}
+
+	goldenFile << "# rom input seed frame framebuffer_hash instructions, written by Chip8-Regression --update\n";
+	for (const RegressionCase& regressionCase : cases)
+	{
+		auto checkpoints{ golden.find(caseKey(regressionCase)) };
+		if (checkpoints == golden.end()) continue;
+
+		for (const Checkpoint& checkpoint : checkpoints->second)
+		{
+			goldenFile << caseKey(regressionCase) << ' ' << checkpoint.frame << ' '
+				<< std::hex << std::setw(16) << std::setfill('0') << checkpoint.framebufferHash << std::dec << ' '
+				<< checkpoint.instructions << '\n';
+		}
+	}
+	return static_cast<bool>(goldenFile);
+}
+
+bool RegressionSuite::check(bool update)
+{
+	std::size_t failures{ 0 };
+	for (const RegressionCase& regressionCase : cases)
+	{
+		const std::string key{ caseKey(regressionCase) };
+		std::vector<Checkpoint> reference{ runCase(regressionCase, DISPATCH_MODES[0]) };
+
+		// Only the first differing checkpoint is reported, later ones usually follow from it
+		bool failed{ false };
+		for (std::size_t mode{ 1 }; mode < std::size(DISPATCH_MODES) && !failed; ++mode)
+		{
+			std::vector<Checkpoint> checkpoints{ runCase(regressionCase, DISPATCH_MODES[mode]) };
+			auto [referenceMismatch, mismatch] = std::mismatch(reference.begin(), reference.end(), checkpoints.begin());
+			if (referenceMismatch == reference.end()) continue;
+
+			std::cout << key << ": frame " << referenceMismatch->frame << " differs between "
+				<< dispatchName(DISPATCH_MODES[0]) << " and " << dispatchName(DISPATCH_MODES[mode]) << " ("
+				<< std::hex << referenceMismatch->framebufferHash << " and " << mismatch->framebufferHash << std::dec << ", "
+				<< referenceMismatch->instructions << " and " << mismatch->instructions << " instructions)" << std::endl;
+			failed = true;
+		}
+
+		if (update)
+		{
+			golden[key] = reference;
+		}
+		else if (!failed)
+		{
+			auto expected{ golden.find(key) };
+			if (expected == golden.end())
+			{
+				std::cout << key << ": no golden checkpoints, run with --update to record them" << std::endl;
+				failed = true;
+			}
+			else if (expected->second.size() != reference.size())
+			{
+				std::cout << key << ": " << expected->second.size() << " golden checkpoints, the suite makes "
+					<< reference.size() << std::endl;
+				failed = true;
+			}
+			else
+			{
+				auto [goldenMismatch, mismatch] = std::mismatch(expected->second.begin(), expected->second.end(), reference.begin());
+				if (goldenMismatch != expected->second.end())
+				{
+					std::cout << key << ": frame " << mismatch->frame << " has framebuffer " << std::hex
+						<< mismatch->framebufferHash << " after " << std::dec << mismatch->instructions
+						<< " instructions, expected " << std::hex << goldenMismatch->framebufferHash << " after " << std::dec
+						<< goldenMismatch->instructions << " at frame " << goldenMismatch->frame << std::endl;
+					failed = true;
+				}
+			}
+		}
+
+		if (failed) ++failures;
+	}
+
+	std::cout << cases.size() - failures << " of " << cases.size() << " cases passed" << std::endl;
+	return failures == 0;
+}
+
+bool RegressionSuite::checkAllocations() const
+{
+	enum class Driver
+	{
+		RunFrame,
+		Run,
+		Cycle
+	};
+	constexpr std::pair<Driver, const char*> DRIVERS[]
+	{
+		{ Driver::RunFrame, "runFrame()" },
+		{ Driver::Run, "run()" },
+		{ Driver::Cycle, "cycle()" }
+	};
+
+	std::size_t failures{ 0 };
+	for (const RegressionCase& regressionCase : cases)
+	{
+		const input_script_type* script{ (regressionCase.input == "-") ? nullptr : &inputScripts.at(regressionCase.input) };
+
+		for (Chip8::Dispatch dispatch : DISPATCH_MODES)
+		{
+			for (const auto& [driver, driverName] : DRIVERS)
+			{
+				auto chip8{ std::make_unique<Chip8>() };
+				chip8->setDispatch(dispatch);
+				startCase(regressionCase, *chip8);
+
+				// Whatever the core sets up lazily is done by the end of the warm-up
+				std::size_t nextEvent{ 0 };
+				std::uint64_t allocationsBefore{ 0 };
+				for (std::uint32_t frame{ 0 }; frame < regressionCase.frames; ++frame)
+				{
+					if (frame == WARMUP_FRAMES) allocationsBefore = AllocationCounter::count();
+					Headless::pressKeys(script, nextEvent, frame, *chip8);
+
+					switch (driver)
+					{
+					case Driver::RunFrame:
+						chip8->runFrame();
+						break;
+					case Driver::Run:
+						chip8->run(chip8->getInstructionsPerFrame());
+						break;
+					case Driver::Cycle:
+						for (std::uint32_t i{ 0 }; i < chip8->getInstructionsPerFrame(); ++i) chip8->cycle();
+						break;
+					}
+				}
+				if (regressionCase.frames <= WARMUP_FRAMES) continue;
+
+				std::uint64_t allocations{ AllocationCounter::count() - allocationsBefore };
+				if (allocations != 0)
+				{
+					std::cout << caseKey(regressionCase) << ": " << driverName << " with " << dispatchName(dispatch)
+						<< " allocated " << allocations << " times in " << regressionCase.frames - WARMUP_FRAMES
+						<< " frames after the warm-up" << std::endl;
+					++failures;
+				}
+			}
+		}
+	}
+
+	if (failures == 0) std::cout << "No allocations once running, in any case or dispatch mode" << std::endl;
+	return failures == 0;
+}
+
+void RegressionSuite::measure(double minimumMs)
+{
+	for (std::size_t i{ 0 }; i < cases.size(); ++i)
+	{
+		performance[i].clear();
+		for (Chip8::Dispatch dispatch : DISPATCH_MODES)
+		{
+			Performance result{ dispatch };
+			double totalMs{ 0.0 };
+			do
+			{
+				auto start = std::chrono::steady_clock::now();
+				std::vector<Checkpoint> checkpoints{ runCase(cases[i], dispatch) };
+				double wallMs{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() };
+
+				if (result.runs++ == 0 || wallMs < result.wallMs) result.wallMs = wallMs;
+				result.instructions = checkpoints.back().instructions;
+				totalMs += wallMs;
+			} while (totalMs < minimumMs);
+
+			performance[i].push_back(result);
+		}
+	}
+}
+
+void RegressionSuite::writePerformance(std::ostream& out) const
+{
+	out << "rom,input,seed,frames,dispatch,runs,instructions,wall_ms,instructions_per_second\n";
+	for (std::size_t i{ 0 }; i < cases.size(); ++i)
+	{
+		const RegressionCase& regressionCase{ cases[i] };
+		for (const Performance& result : performance[i])
+		{
+			out << regressionCase.rom << ',' << regressionCase.input << ',' << regressionCase.seed << ','
+				<< regressionCase.frames << ',' << dispatchName(result.dispatch) << ',' << result.runs << ','
+				<< result.instructions << ',' << std::fixed << std::setprecision(3) << result.wallMs << ','
+				<< std::setprecision(0) << static_cast<double>(result.instructions) / (result.wallMs / 1000.0) << '\n';
+		}
+	}
+}
+
+bool RegressionSuite::compareBaseline(const std::string& filename, double tolerance) const
+{
+	std::ifstream baselineFile{ filename };
+	if (!baselineFile)
+	{
+		std::cout << "Failed to open " << filename << std::endl;
+		return false;
+	}
+
+	// Keyed by "<rom> <input> <seed> <dispatch>"
+	std::map<std::string, double> baseline{};
+	std::string line{};
+	std::getline(baselineFile, line);
+	while (std::getline(baselineFile, line))
+	{
+		std::vector<std::string> fields{};
+		std::istringstream row{ line };
+		for (std::string field{}; std::getline(row, field, ',');)
+		{
+			fields.push_back(field);
+		}
+		if (fields.size() != 9) continue;
+
+		baseline[fields[0] + ' ' + fields[1] + ' ' + fields[2] + ' ' + fields[4]] = std::stod(fields[8]);
+	}
+
+	std::size_t slower{ 0 };
+	for (std::size_t i{ 0 }; i < cases.size(); ++i)
+	{
+		for (const Performance& result : performance[i])
+		{
+			auto before{ baseline.find(caseKey(cases[i]) + ' ' + dispatchName(result.dispatch)) };
+			if (before == baseline.end()) continue;
+
+			double now{ static_cast<double>(result.instructions) / (result.wallMs / 1000.0) };
+			if (now < before->second * (1.0 - tolerance))
+			{
+				std::cout << caseKey(cases[i]) << ' ' << dispatchName(result.dispatch) << ": " << std::fixed
+					<< std::setprecision(0) << now << " instructions/s, was " << before->second << std::endl;
+				++slower;
+			}
+		}
+	}
+	return slower == 0;
+}
+
+#if defined(CHIP8_PROFILE)
+bool RegressionSuite::writeProfiles(const std::string& directory) const
+{
+	// Only the file names, so every case's profile lands straight in directory
+	auto baseName = [](const std::string& path)
+	{
+		return path.substr(path.find_last_of("/\\") + 1);
+	};
+
+	for (const RegressionCase& regressionCase : cases)
+	{
+		auto chip8{ std::make_unique<Chip8>() };
+		chip8->setDispatch(Chip8::Dispatch::Table);
+		runCase(regressionCase, *chip8);
+
+		std::string input{ (regressionCase.input == "-") ? "none" : baseName(regressionCase.input) };
+		std::string prefix{ directory + '/' + baseName(regressionCase.rom) + '-' + input + '-' + std::to_string(regressionCase.seed) };
+		if (!Profiler::write(*chip8, prefix)) return false;
+	}
+	return true;
+}
+#endif
+
+// A checkpoint after every interval frames, and one after the last frame
+std::vector<Checkpoint> RegressionSuite::runCase(const RegressionCase& regressionCase, Chip8::Dispatch dispatch) const
+{
+	auto chip8{ std::make_unique<Chip8>() };
+	chip8->setDispatch(dispatch);
+	return runCase(regressionCase, *chip8);
+}
+
+// Plays the case on a freshly created machine, which is left as the last frame did
+std::vector<Checkpoint> RegressionSuite::runCase(const RegressionCase& regressionCase, Chip8& chip8) const
+{
+	startCase(regressionCase, chip8);
+
+	const input_script_type* script{ (regressionCase.input == "-") ? nullptr : &inputScripts.at(regressionCase.input) };
+	std::size_t nextEvent{ 0 };
+
+	std::vector<Checkpoint> checkpoints{};
+	for (std::uint32_t frame{ 0 }; frame < regressionCase.frames; ++frame)
+	{
+		Headless::pressKeys(script, nextEvent, frame, chip8);
+		if (regressionCase.driver == RegressionCase::Driver::Run)
+		{
+			chip8.run(chip8.getInstructionsPerFrame());
+		}
+		else
+		{
+			chip8.runFrame();
+		}
+
+		std::uint32_t completed{ frame + 1 };
+		if (completed % regressionCase.interval == 0 || completed == regressionCase.frames)
+		{
+			checkpoints.push_back(Checkpoint{ completed, Headless::hashFramebuffer(chip8.getFramebuffer()), chip8.getInstructionCount() });
+		}
+	}
+	return checkpoints;
+}
+
+void RegressionSuite::startCase(const RegressionCase& regressionCase, Chip8& chip8) const
+{
+	chip8.setPlatform(Chip8::platformForRom(regressionCase.rom));
+	chip8.loadRom(roms.at(regressionCase.rom));
+	chip8.seedRng(regressionCase.seed);
+}
+
+std::string RegressionSuite::caseKey(const RegressionCase& regressionCase)
+{
+	return regressionCase.rom + ' ' + regressionCase.input + ' ' + std::to_string(regressionCase.seed);
+}
+
+const char* RegressionSuite::dispatchName(Chip8::Dispatch dispatch)
+{
+	switch (dispatch)
+	{
+	case Chip8::Dispatch::Switch:	return "switch";
+	case Chip8::Dispatch::Table:	return "table";
+	case Chip8::Dispatch::Cached:	return "cached";
+	}
+	return "unknown";
+}
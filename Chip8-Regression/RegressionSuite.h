@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Chip8.h"
+#include "Headless.h"
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// One line of a suite file, see README.md
+struct RegressionCase
+{
+	std::string rom{};
+	std::string input{};		// Input script, or "-" for none
+	std::uint32_t seed{};
+	std::uint32_t frames{};
+	std::uint32_t interval{};	// Frames between checkpoints
+
+	// How each frame is played
+	enum class Driver
+	{
+		RunFrame,	// Chip8::runFrame()
+		Run			// Chip8::run() with a frame's worth of instructions, counted in full even while FX0A waits
+	};
+
+	Driver driver{ Driver::RunFrame };
+};
+
+// The machine at the end of a checkpoint frame
+struct Checkpoint
+{
+	std::uint32_t frame{};
+	std::uint64_t framebufferHash{};
+	std::uint64_t instructions{};
+
+	bool operator==(const Checkpoint& other) const
+	{
+		return frame == other.frame && framebufferHash == other.framebufferHash && instructions == other.instructions;
+	}
+
+	bool operator!=(const Checkpoint& other) const
+	{
+		return !(*this == other);
+	}
+};
+
+struct Performance
+{
+	Chip8::Dispatch dispatch{};
+	std::uint32_t runs{};
+	std::uint64_t instructions{};	// In one run
+	double wallMs{};				// Of the fastest run, the others are slowed by whatever else the host was doing
+};
+
+// Runs every case in a suite file headlessly, checks its display at each checkpoint against golden hashes and
+// times how many instructions per second each dispatch mode manages on it
+class RegressionSuite
+{
+public:
+	// Also loads every ROM and input script the cases name
+	bool loadSuite(const std::string& filename);
+
+	bool loadGolden(const std::string& filename);
+	bool saveGolden(const std::string& filename) const;
+
+	// Runs each case under every dispatch mode, reporting each one whose checkpoints differ between modes or from
+	// the golden ones. Returns true when none do. With update set the golden checkpoints are replaced instead.
+	bool check(bool update);
+
+	// Plays each case under every dispatch mode, driven by runFrame(), run() and cycle() in turn, and reports each
+	// one that allocates after its first WARMUP_FRAMES frames. Returns true when none do.
+	bool checkAllocations() const;
+
+	// Repeats each case under every dispatch mode until at least minimumMs has been spent on it, and keeps the
+	// fastest run
+	void measure(double minimumMs);
+	void writePerformance(std::ostream& out) const;
+
+	// Reports each case and dispatch mode running more than tolerance slower than in an earlier writePerformance()
+	// file, returns true when none do
+	bool compareBaseline(const std::string& filename, double tolerance) const;
+
+#if defined(CHIP8_PROFILE)
+	// Runs each case once with Dispatch::Table and writes what it executed with Profiler::write(), to
+	// <directory>/<rom>-<input>-<seed>.*, naming an input of "-" "none"
+	bool writeProfiles(const std::string& directory) const;
+#endif
+
+	std::size_t caseCount() const
+	{
+		return cases.size();
+	}
+
+private:
+	static constexpr std::uint32_t WARMUP_FRAMES{ 60 };
+
+	using input_script_type = Headless::input_script_type;
+
+	std::vector<RegressionCase> cases{};
+	std::vector<std::vector<Performance>> performance{};	// Indexed like cases, one entry per dispatch mode
+
+	std::map<std::string, std::vector<std::uint8_t>> roms{};
+	std::map<std::string, input_script_type> inputScripts{};
+	std::map<std::string, std::vector<Checkpoint>> golden{};	// Keyed by caseKey()
+
+	std::vector<Checkpoint> runCase(const RegressionCase& regressionCase, Chip8::Dispatch dispatch) const;
+	std::vector<Checkpoint> runCase(const RegressionCase& regressionCase, Chip8& chip8) const;
+	void startCase(const RegressionCase& regressionCase, Chip8& chip8) const;
+
+	static std::string caseKey(const RegressionCase& regressionCase);
+	static const char* dispatchName(Chip8::Dispatch dispatch);
+};
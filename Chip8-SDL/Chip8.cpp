@@ -1,22 +1,317 @@
 #include "Chip8.h"
 
+#include <algorithm>
+#include <bitset>
+#include <cctype>
+#include <cstddef>
+#include <cstring>
 #include <stdexcept>
 #include <fstream>
 #include <iostream>
+#include <type_traits>
 #include <vector>
 
+static_assert(std::is_trivially_copyable<Chip8::State>::value, "Chip8::State must copy without allocating");
+
+// Counting for Profiler, which builds without CHIP8_PROFILE leave out entirely
+#if defined(CHIP8_PROFILE)
+#define CHIP8_PROFILE_ONLY(...) __VA_ARGS__
+#else
+#define CHIP8_PROFILE_ONLY(...)
+#endif
+
+namespace
+{
+	constexpr char SAVE_STATE_MAGIC[4]{ 'C', '8', 'S', 'S' };
+	constexpr std::uint32_t SAVE_STATE_VERSION{ 1 };	// Bump whenever SaveStateRecord changes
+
+	constexpr std::uint8_t SAVE_STATE_WAITING_FOR_KEY{ 0x01 };
+	constexpr std::uint8_t SAVE_STATE_DISPLAY_WAIT{ 0x02 };
+	constexpr std::uint8_t SAVE_STATE_STACK_FAULTED{ 0x04 };
+
+	// Save state file layout, written and read with a single copy.
+	// Largest fields first so no padding depends on the compiler. Multi-byte fields are in host order, which is
+	// little-endian on everything the projects build for.
+	struct SaveStateRecord
+	{
+		char magic[4];
+		std::uint32_t version;
+		std::uint64_t instructionCount;
+		Chip8::Rng rng;
+		Chip8::framebuffer_type display;
+		std::uint32_t instructionsPerFrame;
+		std::uint32_t frameInstructions;
+		std::array<std::uint16_t, Chip8::STACK_SIZE> stack;
+		std::uint16_t ir;
+		std::uint16_t pc;
+		std::uint16_t keys;		// Bit n is set while key n is held
+		Chip8::memory_type memory;
+		std::array<std::uint8_t, 16> registers;
+		std::uint8_t sp;
+		std::uint8_t delayTimer;
+		std::uint8_t soundTimer;
+		std::uint8_t platform;	// Selects the quirks, see Chip8::Platform
+		std::uint8_t flags;		// SAVE_STATE_* bits
+		std::array<std::uint8_t, 5> reserved;
+	};
+
+	static_assert(std::is_trivially_copyable<SaveStateRecord>::value, "Save states are read and written with memcpy");
+	static_assert(sizeof(SaveStateRecord) == 4456, "Save state layout must not depend on the compiler");
+}
+
 Chip8::Chip8()
 {
+	static_assert(offsetof(Chip8, dispatch) + sizeof(dispatch) <= 64, "Everything cycle() reads must share the first cache line");
 	reset();
 }
 
+void Chip8::setDispatch(Dispatch mode)
+{
+	dispatch = mode;
+
+	if (dispatch == Dispatch::Cached && decodeCache.empty())
+	{
+		decodeCache.resize(DECODE_CACHE_SIZE);
+	}
+}
+
+void Chip8::setInstructionsPerFrame(std::uint32_t instructions)
+{
+	instructionsPerFrame = std::max<std::uint32_t>(instructions, 1);
+	frameInstructions %= instructionsPerFrame;
+}
+
+std::uint32_t Chip8::getInstructionsPerFrame() const
+{
+	return instructionsPerFrame;
+}
+
+void Chip8::setDisplayWait(bool enabled)
+{
+	displayWait = enabled;
+}
+
+bool Chip8::getDisplayWait() const
+{
+	return displayWait;
+}
+
+void Chip8::seedRng(std::uint32_t seed, std::uint32_t stream)
+{
+	rng.seed(seed, stream);
+}
+
+void Chip8::setPlatform(Platform platform)
+{
+	profile = &profiles[static_cast<std::size_t>(platform)];
+}
+
+Chip8::Platform Chip8::getPlatform() const
+{
+	return profile->platform;
+}
+
+Chip8::State Chip8::fork() const
+{
+	State state{};
+	state.memory = memory;
+	state.display = display;
+	state.registers = registers;
+	state.stack = stack;
+	state.sp = sp;
+	state.stackFaulted = stackFaulted;
+	state.ir = ir;
+	state.pc = pc;
+	state.delayTimer = delayTimer;
+	state.soundTimer = soundTimer;
+	state.instructionsPerFrame = instructionsPerFrame;
+	state.frameInstructions = frameInstructions;
+	state.instructionCount = instructionCount;
+	state.keypad = keypad;
+	state.waitingForKey = waitingForKey;
+	state.displayWait = displayWait;
+	state.platform = profile->platform;
+	state.rng = rng;
+	return state;
+}
+
+void Chip8::restore(const State& state)
+{
+	memory = state.memory;
+	display = state.display;
+	registers = state.registers;
+	stack = state.stack;
+	sp = state.sp;
+	stackFaulted = state.stackFaulted;
+	ir = state.ir;
+	pc = state.pc;
+	delayTimer = state.delayTimer;
+	soundTimer = state.soundTimer;
+	instructionsPerFrame = state.instructionsPerFrame;
+	frameInstructions = state.frameInstructions;
+	instructionCount = state.instructionCount;
+	keypad = state.keypad;
+	waitingForKey = state.waitingForKey;
+	displayWait = state.displayWait;
+	setPlatform(state.platform);
+	rng = state.rng;
+
+	endFrameOnDraw = false;
+	dirtyRows = ALL_ROWS_DIRTY;
+	invalidateDecoded(MEM_START, MEMORY_SIZE - MEM_START);
+}
+
+std::vector<std::uint8_t> Chip8::saveState() const
+{
+	State state{ fork() };
+
+	SaveStateRecord record{};
+	std::memcpy(record.magic, SAVE_STATE_MAGIC, sizeof(record.magic));
+	record.version = SAVE_STATE_VERSION;
+	record.instructionCount = state.instructionCount;
+	record.rng = state.rng;
+	record.display = state.display;
+	record.instructionsPerFrame = state.instructionsPerFrame;
+	record.frameInstructions = state.frameInstructions;
+	record.stack = state.stack;
+	record.ir = state.ir;
+	record.pc = state.pc;
+	for (int key{ 0 }; key < KEY_COUNT; ++key)
+	{
+		if (state.keypad[key]) record.keys |= static_cast<std::uint16_t>(1 << key);
+	}
+	record.memory = state.memory;
+	record.registers = state.registers;
+	record.sp = state.sp;
+	record.delayTimer = state.delayTimer;
+	record.soundTimer = state.soundTimer;
+	record.platform = static_cast<std::uint8_t>(state.platform);
+	if (state.waitingForKey) record.flags |= SAVE_STATE_WAITING_FOR_KEY;
+	if (state.displayWait) record.flags |= SAVE_STATE_DISPLAY_WAIT;
+	if (state.stackFaulted) record.flags |= SAVE_STATE_STACK_FAULTED;
+
+	std::vector<std::uint8_t> data(sizeof(record));
+	std::memcpy(data.data(), &record, sizeof(record));
+	return data;
+}
+
+bool Chip8::saveState(const std::string& filename) const
+{
+	std::vector<std::uint8_t> data{ saveState() };
+
+	std::ofstream stateFile{ filename, std::ios::binary };
+	if (!stateFile.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size())))
+	{
+		std::cout << "Failed to write " << filename << '\n';
+		return false;
+	}
+	return true;
+}
+
+bool Chip8::loadState(const std::vector<std::uint8_t>& data)
+{
+	SaveStateRecord record{};
+	std::size_t header{ sizeof(record.magic) + sizeof(record.version) };
+	if (data.size() < header || std::memcmp(data.data(), SAVE_STATE_MAGIC, sizeof(record.magic)) != 0)
+	{
+		std::cout << "Not a save state.\n";
+		return false;
+	}
+
+	std::memcpy(&record, data.data(), header);
+	if (record.version != SAVE_STATE_VERSION)
+	{
+		std::cout << "Unsupported save state version " << record.version << ".\n";
+		return false;
+	}
+
+	if (data.size() == sizeof(record)) std::memcpy(&record, data.data(), sizeof(record));
+	if (data.size() != sizeof(record) || record.pc > MEMORY_SIZE - 2 || record.sp > STACK_SIZE || record.platform > static_cast<std::uint8_t>(Platform::XoChip) ||
+		record.instructionsPerFrame == 0 || record.frameInstructions >= record.instructionsPerFrame)
+	{
+		std::cout << "Save state is corrupt.\n";
+		return false;
+	}
+
+	State state{};
+	state.memory = record.memory;
+	state.display = record.display;
+	state.registers = record.registers;
+	state.stack = record.stack;
+	state.sp = record.sp;
+	state.stackFaulted = (record.flags & SAVE_STATE_STACK_FAULTED) != 0;
+	state.ir = record.ir;
+	state.pc = record.pc;
+	state.delayTimer = record.delayTimer;
+	state.soundTimer = record.soundTimer;
+	state.instructionsPerFrame = record.instructionsPerFrame;
+	state.frameInstructions = record.frameInstructions;
+	state.instructionCount = record.instructionCount;
+	for (int key{ 0 }; key < KEY_COUNT; ++key)
+	{
+		state.keypad[key] = static_cast<std::uint8_t>((record.keys >> key) & 1);
+	}
+	state.waitingForKey = (record.flags & SAVE_STATE_WAITING_FOR_KEY) != 0;
+	state.displayWait = (record.flags & SAVE_STATE_DISPLAY_WAIT) != 0;
+	state.platform = static_cast<Platform>(record.platform);
+	state.rng = record.rng;
+
+	restore(state);
+	return true;
+}
+
+bool Chip8::loadState(const std::string& filename)
+{
+	std::ifstream stateFile{ filename, std::ios::binary };
+	if (!stateFile)
+	{
+		std::cout << "File not found.\n";
+		return false;
+	}
+
+	return loadState(std::vector<std::uint8_t>(std::istreambuf_iterator<char>(stateFile), {}));
+}
+
+// Only .xo8 is unambiguous. Plain .ch8 files are left on the SUPER-CHIP quirks the core has always used,
+// since test ROMs such as bc_test rely on them; the VIP profile has to be selected with setPlatform().
+Chip8::Platform Chip8::platformForRom(const std::string& filename)
+{
+	std::size_t dot{ filename.find_last_of('.') };
+	if (dot == std::string::npos) return Platform::SuperChip;
+
+	std::string extension{ filename.substr(dot + 1) };
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+	if (extension == "xo8") return Platform::XoChip;
+	return Platform::SuperChip;
+}
+
 void Chip8::reset()
 {
 	pc = MEM_START;
-	for (int i = 0; i < fontChars.size(); i++)
+	frameInstructions = 0;
+	instructionCount = 0;
+	waitingForKey = false;
+	sp = 0;
+	stackFaulted = false;
+	CHIP8_PROFILE_ONLY(executionProfile = ExecutionProfile{});
+	std::copy(FONTCHARS.begin(), FONTCHARS.end(), memory.begin() + FONTCHAR_START);
+}
+
+Chip8::display_type Chip8::getDisplay() const
+{
+	display_type rgba{};
+
+	for (int y{ 0 }; y < DISPLAY_HEIGHT; ++y)
 	{
-		memory[FONTCHAR_START + i] = fontChars[i];
+		std::uint64_t displayRow{ display[y] };
+		for (int x{ 0 }; x < DISPLAY_WIDTH; ++x)
+		{
+			rgba[(y * DISPLAY_WIDTH) + x] = ((displayRow >> (63 - x)) & 1) ? 0xFFFFFFFF : 0;
+		}
 	}
+
+	return rgba;
 }
 
 bool Chip8::loadRom(const std::string& filename)
@@ -28,13 +323,10 @@ bool Chip8::loadRom(const std::string& filename)
 		return false;
 	}
 
+	setPlatform(platformForRom(filename));
+
 	// From https://stackoverflow.com/a/5420568
-	int i = 0;
-	for (unsigned char c : std::vector<std::uint8_t>(std::istreambuf_iterator<char>(romFile), {}))
-	{
-		memory[MEM_START + i] = c;
-		++i;
-	}
+	if (!loadRom(std::vector<std::uint8_t>(std::istreambuf_iterator<char>(romFile), {}))) return false;
 	std::cout << std::hex;
 
 	for (int j = 0; j < memory.size(); ++j)
@@ -46,6 +338,19 @@ bool Chip8::loadRom(const std::string& filename)
 	return true;
 }
 
+bool Chip8::loadRom(const std::vector<std::uint8_t>& rom)
+{
+	if (rom.size() > MAX_ROM_SIZE)
+	{
+		std::cout << "ROM too large.\n";
+		return false;
+	}
+
+	std::copy(rom.begin(), rom.end(), memory.begin() + MEM_START);
+	invalidateDecoded(MEM_START, MEMORY_SIZE - MEM_START);
+	return true;
+}
+
 std::uint16_t Chip8::fetch()
 {
 	std::uint8_t byteOne{ memory[pc] };
@@ -55,254 +360,660 @@ std::uint16_t Chip8::fetch()
 	return (byteOne << 8) | byteTwo;
 }
 
+#if defined(CHIP8_PROFILE)
+// Count the instruction about to be fetched from pc, by the handler decodeTable picks for it
+void Chip8::profileInstruction()
+{
+	if (pc > MEMORY_SIZE - 2) return;
+
+	std::uint16_t opcode{ static_cast<std::uint16_t>((memory[pc] << 8) | memory[pc + 1]) };
+	++executionProfile.addresses[pc];
+	++executionProfile.handlers[static_cast<std::size_t>(decodeTable[opcode])];
+}
+
+// run() is using up the rest of its instructions waiting in FX0A, without fetching them
+void Chip8::profileKeyWait(std::size_t skipped)
+{
+	executionProfile.keyWaitInstructions += skipped;
+	executionProfile.fastForwarded += skipped;
+}
+#endif
+
+Chip8::Instruction Chip8::decodeOperands(std::uint16_t opcode)
+{
+	Instruction inst{};
+	inst.opcode = opcode;
+	inst.nnn = opcode & BITMASK_NNN;
+	inst.nn = static_cast<std::uint8_t>(opcode & BITMASK_NN);
+	inst.n = static_cast<std::uint8_t>(opcode & BITMASK_N);
+	inst.x = static_cast<std::uint8_t>((opcode & BITMASK_X) >> 8);
+	inst.y = static_cast<std::uint8_t>((opcode & BITMASK_Y) >> 4);
+	return inst;
+}
+
+Chip8::Instruction Chip8::decodeInstruction(std::uint16_t opcode)
+{
+	Instruction inst{ decodeOperands(opcode) };
+	inst.op = decodeTable[opcode];
+	return inst;
+}
+
+// Same as decodeInstruction(fetch()), but ROM addresses are only decoded once
+Chip8::Instruction Chip8::fetchCached()
+{
+	if (pc < MEM_START || pc >= MEM_START + DECODE_CACHE_SIZE)
+	{
+		return decodeInstruction(fetch());
+	}
+
+	Instruction& entry{ decodeCache[pc - MEM_START] };
+	if (!entry.cached)
+	{
+		entry = decodeInstruction(static_cast<std::uint16_t>((memory[pc] << 8) | memory[pc + 1]));
+		entry.cached = true;
+	}
+	pc += 2;
+
+	return entry;
+}
+
+// Drop every cached instruction that reads a byte in [address, address + length)
+void Chip8::invalidateDecoded(std::size_t address, std::size_t length)
+{
+	if (decodeCache.empty() || length == 0) return;
+
+	// An instruction starting one byte earlier also covers the first written byte
+	std::size_t first{ (address > MEM_START) ? address - 1 : MEM_START };
+	std::size_t last{ std::min(address + length, MEM_START + DECODE_CACHE_SIZE) };
+
+	for (std::size_t i{ first }; i < last; ++i)
+	{
+		decodeCache[i - MEM_START].cached = false;
+	}
+}
+
+// Advance the virtual clock by the given number of instructions, as cycle() would,
+// decrementing both timers once for every instructionsPerFrame that complete
+void Chip8::tickTimers(std::size_t instructions)
+{
+	std::size_t elapsed{ frameInstructions + instructions };
+	std::size_t ticks{ elapsed / instructionsPerFrame };
+	frameInstructions = static_cast<std::uint32_t>(elapsed % instructionsPerFrame);
+
+	delayTimer = static_cast<std::uint8_t>((delayTimer > ticks) ? delayTimer - ticks : 0);
+	soundTimer = static_cast<std::uint8_t>((soundTimer > ticks) ? soundTimer - ticks : 0);
+}
+
+// Only the first fault is reported, pc is still past the failing 2NNN/00EE
+void Chip8::faultStack(const char* error)
+{
+	if (stackFaulted) return;
+
+	stackFaulted = true;
+	std::cout << error << " at 0x" << std::hex << (pc - 2) << std::dec << std::endl;
+}
+
 void Chip8::cycle()
 {
-	auto currentTime = std::chrono::high_resolution_clock::now();
-	double elapsedTime = std::chrono::duration<double, std::milli>(currentTime - delayLastTick).count();
+	tickTimers(1);
+	++instructionCount;
+	CHIP8_PROFILE_ONLY(profileInstruction());
 
-	if (elapsedTime > (1 / DELAY_TIMER_HZ))
+	Instruction inst{};
+	switch (dispatch)
 	{
-		if (delayTimer > 0) --delayTimer;
-		if (soundTimer > 0) --soundTimer;
+	case Dispatch::Switch:
+		(this->*profile->dispatchSwitch)(decodeOperands(fetch()));
+		return;
+	case Dispatch::Table:
+		inst = decodeInstruction(fetch());
+		break;
+	case Dispatch::Cached:
+		inst = fetchCached();
+		break;
 	}
 
-	opcode = fetch();
+	(this->*(*profile->handlers)[static_cast<std::size_t>(inst.op)])(inst);
+}
 
-	int nibOne	{ (opcode & 0xF000) >> 12};
-	int nibTwo	{ (opcode & 0x0F00) >> 8};
-	int nibThree{ (opcode & 0x00F0) >> 4};
-	int nibFour	{ opcode & 0x000F };
+// Execute the given number of instructions in one call.
+// Decodes through decodeTable (or decodeCache with Dispatch::Cached), and the virtual clock is only advanced when a timer is used.
+// Idle loops waiting on the delay timer are fast-forwarded to its next tick, and FX0A waiting for a key uses up the rest
+// of the call, since the keypad can't change until it returns.
+// GCC and Clang builds thread the handlers with computed goto so each one jumps straight to the next.
+void Chip8::run(std::size_t instructions)
+{
+	(this->*profile->run)(instructions);
+}
+
+// Execute the rest of the current frame, so the timers tick exactly once.
+// With the display wait quirk a DXYN skips whatever is left of the frame, as the VIP idled until vblank.
+Chip8::FrameResult Chip8::runFrame()
+{
+	// Only report rows changed by this frame, but keep earlier ones dirty for the renderer
+	std::uint32_t dirtyBefore{ dirtyRows };
+	dirtyRows = 0;
+
+	endFrameOnDraw = displayWait;
+	run(instructionsPerFrame - frameInstructions);
+	endFrameOnDraw = false;
+
+	if (frameInstructions != 0) tickTimers(instructionsPerFrame - frameInstructions);
+
+	FrameResult result{};
+	result.displayChanged = (dirtyRows != 0);
+	result.soundActive = (soundTimer > 0);
+	result.waitingForKey = waitingForKey;
+	result.timersRunning = (delayTimer > 0 || soundTimer > 0);
+
+	dirtyRows |= dirtyBefore;
+	return result;
+}
+
+template<typename Quirks>
+void Chip8::runWith(std::size_t instructions)
+{
+	// Timers are only read or written by FX07/FX15/FX18, so their ticks are applied just before those run
+	std::size_t executed{ 0 };
+	std::size_t ticked{ 0 };
+	auto catchUpTimers = [&]()
+	{
+		tickTimers(executed - ticked);
+		ticked = executed;
+	};
+
+	// A jump to itself, or back to an FX07/3X00 pair polling the delay timer, repeats instructions that change nothing
+	// until the timer ticks. Those repeats are counted as executed without running them, so the result is the same.
+	auto skipIdleLoop = [&](const Instruction& jump)
+	{
+		std::uint16_t jumpAddress{ static_cast<std::uint16_t>(pc - 2) };
+		if (jump.nnn == jumpAddress)
+		{
+			CHIP8_PROFILE_ONLY(executionProfile.fastForwarded += instructions - executed);
+			executed = instructions;
+			return;
+		}
+
+		if (jump.nnn + 4 != jumpAddress) return;
+		std::uint16_t poll{ static_cast<std::uint16_t>((memory[jump.nnn] << 8) | memory[jump.nnn + 1]) };
+		std::uint16_t test{ static_cast<std::uint16_t>((memory[jump.nnn + 2] << 8) | memory[jump.nnn + 3]) };
+		if ((poll & 0xF0FF) != 0xF007 || test != (0x3000 | (poll & BITMASK_X))) return;
+
+		catchUpTimers();
+		std::uint8_t value{ registers[(poll & BITMASK_X) >> 8] };
+		if (delayTimer == 0 || value != delayTimer) return;
+
+		// Every skipped FX07 must still read the current value, so stop short of the next tick
+		std::size_t untilTick{ instructionsPerFrame - frameInstructions - 1 };
+		std::size_t iterations{ std::min((untilTick + 2) / 3, (instructions - executed) / 3) };
+		executed += iterations * 3;
+		CHIP8_PROFILE_ONLY(executionProfile.fastForwarded += iterations * 3);
+	};
+
+	Instruction inst{};
+
+#if defined(__GNUC__)
+	// Must stay in the same order as Chip8::Op
+	static const void* const labels[]
+	{
+		&&op_NOP,
+		&&op_00E0, &&op_00EE, &&op_1NNN, &&op_2NNN, &&op_3XNN, &&op_4XNN, &&op_5XY0, &&op_6XNN, &&op_7XNN,
+		&&op_8XY0, &&op_8XY1, &&op_8XY2, &&op_8XY3, &&op_8XY4, &&op_8XY5, &&op_8XY6, &&op_8XY7, &&op_8XYE,
+		&&op_9XY0, &&op_ANNN, &&op_BNNN, &&op_CXNN, &&op_DXYN, &&op_EX9E, &&op_EXA1,
+		&&op_FX07, &&op_FX0A, &&op_FX15, &&op_FX18, &&op_FX1E, &&op_FX29, &&op_FX33, &&op_FX55, &&op_FX65
+	};
+	static_assert(sizeof(labels) / sizeof(labels[0]) == static_cast<std::size_t>(Op::COUNT), "labels does not match Chip8::Op");
+
+#define CHIP8_DISPATCH() \
+	if (executed == instructions) goto done; \
+	++executed; \
+	CHIP8_PROFILE_ONLY(profileInstruction()); \
+	inst = (dispatch == Dispatch::Cached) ? fetchCached() : decodeInstruction(fetch()); \
+	goto *labels[static_cast<std::size_t>(inst.op)]
+
+	CHIP8_DISPATCH();
+
+op_NOP:		CHIP8_DISPATCH();
+op_00E0:	opcode_00E0(inst); CHIP8_DISPATCH();
+op_00EE:	opcode_00EE(inst); CHIP8_DISPATCH();
+op_1NNN:	skipIdleLoop(inst); opcode_1NNN(inst); CHIP8_DISPATCH();
+op_2NNN:	opcode_2NNN(inst); CHIP8_DISPATCH();
+op_3XNN:	opcode_3XNN(inst); CHIP8_DISPATCH();
+op_4XNN:	opcode_4XNN(inst); CHIP8_DISPATCH();
+op_5XY0:	opcode_5XY0(inst); CHIP8_DISPATCH();
+op_6XNN:	opcode_6XNN(inst); CHIP8_DISPATCH();
+op_7XNN:	opcode_7XNN(inst); CHIP8_DISPATCH();
+op_8XY0:	opcode_8XY0(inst); CHIP8_DISPATCH();
+op_8XY1:	opcode_8XY1(inst); CHIP8_DISPATCH();
+op_8XY2:	opcode_8XY2(inst); CHIP8_DISPATCH();
+op_8XY3:	opcode_8XY3(inst); CHIP8_DISPATCH();
+op_8XY4:	opcode_8XY4(inst); CHIP8_DISPATCH();
+op_8XY5:	opcode_8XY5(inst); CHIP8_DISPATCH();
+op_8XY6:	opcode_8XY6<Quirks>(inst); CHIP8_DISPATCH();
+op_8XY7:	opcode_8XY7(inst); CHIP8_DISPATCH();
+op_8XYE:	opcode_8XYE<Quirks>(inst); CHIP8_DISPATCH();
+op_9XY0:	opcode_9XY0(inst); CHIP8_DISPATCH();
+op_ANNN:	opcode_ANNN(inst); CHIP8_DISPATCH();
+op_BNNN:	opcode_BNNN<Quirks>(inst); CHIP8_DISPATCH();
+op_CXNN:	opcode_CXNN(inst); CHIP8_DISPATCH();
+op_DXYN:	opcode_DXYN(inst); if (endFrameOnDraw) goto done; CHIP8_DISPATCH();
+op_EX9E:	opcode_EX9E(inst); CHIP8_DISPATCH();
+op_EXA1:	opcode_EXA1(inst); CHIP8_DISPATCH();
+op_FX07:	catchUpTimers(); opcode_FX07(inst); CHIP8_DISPATCH();
+op_FX0A:	opcode_FX0A(inst); if (waitingForKey) { CHIP8_PROFILE_ONLY(profileKeyWait(instructions - executed)); executed = instructions; } CHIP8_DISPATCH();
+op_FX15:	catchUpTimers(); opcode_FX15(inst); CHIP8_DISPATCH();
+op_FX18:	catchUpTimers(); opcode_FX18(inst); CHIP8_DISPATCH();
+op_FX1E:	opcode_FX1E(inst); CHIP8_DISPATCH();
+op_FX29:	opcode_FX29(inst); CHIP8_DISPATCH();
+op_FX33:	opcode_FX33(inst); CHIP8_DISPATCH();
+op_FX55:	opcode_FX55<Quirks>(inst); CHIP8_DISPATCH();
+op_FX65:	opcode_FX65<Quirks>(inst); CHIP8_DISPATCH();
+
+#undef CHIP8_DISPATCH
+
+done:
+#else
+	// Labels as values are a GCC extension, other compilers loop over the handler table
+	while (executed < instructions)
+	{
+		++executed;
+		CHIP8_PROFILE_ONLY(profileInstruction());
+		inst = (dispatch == Dispatch::Cached) ? fetchCached() : decodeInstruction(fetch());
+
+		if (inst.op == Op::OP_FX07 || inst.op == Op::OP_FX15 || inst.op == Op::OP_FX18) catchUpTimers();
+		if (inst.op == Op::OP_1NNN) skipIdleLoop(inst);
+		(this->*handlerTable<Quirks>[static_cast<std::size_t>(inst.op)])(inst);
+		if (endFrameOnDraw && inst.op == Op::OP_DXYN) break;
+		if (inst.op == Op::OP_FX0A && waitingForKey)
+		{
+			CHIP8_PROFILE_ONLY(profileKeyWait(instructions - executed));
+			executed = instructions;
+			break;
+		}
+	}
+#endif
+
+	catchUpTimers();
+	instructionCount += executed;
+}
+
+template<typename Quirks>
+void Chip8::dispatchSwitch(const Instruction& inst)
+{
+	int nibOne	{ (inst.opcode & 0xF000) >> 12};
+	int nibTwo	{ (inst.opcode & 0x0F00) >> 8};
+	int nibThree{ (inst.opcode & 0x00F0) >> 4};
+	int nibFour	{ inst.opcode & 0x000F };
 
 	switch (nibOne)
 	{
 	case 0x0:
 		if (nibTwo == 0x0 && nibThree == 0xE)
 		{
-			if (nibFour == 0) opcode_00E0();
-			else opcode_00EE();
+			if (nibFour == 0) opcode_00E0(inst);
+			else opcode_00EE(inst);
 		}
 		break;
 	case 0x1:
-		opcode_1NNN();
+		opcode_1NNN(inst);
 		break;
 	case 0x2:
-		opcode_2NNN();
+		opcode_2NNN(inst);
 		break;
 	case 0x3:
-		opcode_3XNN();
+		opcode_3XNN(inst);
 		break;
 	case 0x4:
-		opcode_4XNN();
+		opcode_4XNN(inst);
 		break;
 	case 0x5:
-		opcode_5XY0();
+		opcode_5XY0(inst);
 		break;
 	case 0x6:
-		opcode_6XNN();
+		opcode_6XNN(inst);
 		break;
 	case 0x7:
-		opcode_7XNN();
+		opcode_7XNN(inst);
 		break;
 	case 0x8:
 		switch (nibFour)
 		{
 		case 0x0:
-			opcode_8XY0();
+			opcode_8XY0(inst);
 			break;
 		case 0x1:
-			opcode_8XY1();
+			opcode_8XY1(inst);
 			break;
 		case 0x2:
-			opcode_8XY2();
+			opcode_8XY2(inst);
 			break;
 		case 0x3:
-			opcode_8XY3();
+			opcode_8XY3(inst);
 			break;
 		case 0x4:
-			opcode_8XY4();
+			opcode_8XY4(inst);
 			break;
 		case 0x5:
-			opcode_8XY5();
+			opcode_8XY5(inst);
 			break;
 		case 0x6:
-			opcode_8XY6();
+			opcode_8XY6<Quirks>(inst);
 			break;
 		case 0x7:
-			opcode_8XY7();
+			opcode_8XY7(inst);
 			break;
 		case 0xE:
-			opcode_8XYE();
+			opcode_8XYE<Quirks>(inst);
 			break;
 		}
 		break;
 	case 0x9:
-		opcode_9XY0();
+		opcode_9XY0(inst);
 		break;
 	case 0xA:
-		opcode_ANNN();
+		opcode_ANNN(inst);
 		break;
 	case 0xB:
-		opcode_BNNN();
+		opcode_BNNN<Quirks>(inst);
 		break;
 	case 0xC:
-		opcode_CXNN();
+		opcode_CXNN(inst);
 		break;
 	case 0xD:
-		opcode_DXYN();
+		opcode_DXYN(inst);
 		break;
 	case 0xE:
-		if (nibThree == 0x9 && nibFour == 0xE) opcode_EX9E();
-		else opcode_EXA1();
+		if (nibThree == 0x9 && nibFour == 0xE) opcode_EX9E(inst);
+		else opcode_EXA1(inst);
 		break;
 	case 0xF:
 		switch ((nibThree << 4) | nibFour)
 		{
 		case 0x07:
-			opcode_FX07();
+			opcode_FX07(inst);
 			break;
 		case 0x0A:
-			opcode_FX0A();
+			opcode_FX0A(inst);
 			break;	
 		case 0x15:
-			opcode_FX15();
+			opcode_FX15(inst);
 			break;
 		case 0x18:
-			opcode_FX18();
+			opcode_FX18(inst);
 			break;
 		case 0x1E:
-			opcode_FX1E();
+			opcode_FX1E(inst);
 			break;
 		case 0x29:
-			opcode_FX29();
+			opcode_FX29(inst);
 			break;
 		case 0x33:
-			opcode_FX33();
+			opcode_FX33(inst);
 			break;
 		case 0x55:
-			opcode_FX55();
+			opcode_FX55<Quirks>(inst);
 			break;
 		case 0x65:
-			opcode_FX65();
+			opcode_FX65<Quirks>(inst);
 			break;
 		}
 		break;
 	default:
-		std::cout << "\nMissing opcode instruction: 0x" << opcode << '\n';
+		std::cout << "\nMissing opcode instruction: 0x" << inst.opcode << '\n';
+	}
+
+}
+
+// Mirrors the decoding done by dispatchSwitch(), so both dispatch modes execute identical handlers
+constexpr Chip8::Op Chip8::decode(std::uint16_t opcode)
+{
+	int nibOne	{ (opcode & 0xF000) >> 12};
+	int nibTwo	{ (opcode & 0x0F00) >> 8};
+	int nibThree{ (opcode & 0x00F0) >> 4};
+	int nibFour	{ opcode & 0x000F };
+
+	switch (nibOne)
+	{
+	case 0x0:
+		if (nibTwo == 0x0 && nibThree == 0xE) return (nibFour == 0) ? Op::OP_00E0 : Op::OP_00EE;
+		return Op::NOP;
+	case 0x1: return Op::OP_1NNN;
+	case 0x2: return Op::OP_2NNN;
+	case 0x3: return Op::OP_3XNN;
+	case 0x4: return Op::OP_4XNN;
+	case 0x5: return Op::OP_5XY0;
+	case 0x6: return Op::OP_6XNN;
+	case 0x7: return Op::OP_7XNN;
+	case 0x8:
+		switch (nibFour)
+		{
+		case 0x0: return Op::OP_8XY0;
+		case 0x1: return Op::OP_8XY1;
+		case 0x2: return Op::OP_8XY2;
+		case 0x3: return Op::OP_8XY3;
+		case 0x4: return Op::OP_8XY4;
+		case 0x5: return Op::OP_8XY5;
+		case 0x6: return Op::OP_8XY6;
+		case 0x7: return Op::OP_8XY7;
+		case 0xE: return Op::OP_8XYE;
+		}
+		return Op::NOP;
+	case 0x9: return Op::OP_9XY0;
+	case 0xA: return Op::OP_ANNN;
+	case 0xB: return Op::OP_BNNN;
+	case 0xC: return Op::OP_CXNN;
+	case 0xD: return Op::OP_DXYN;
+	case 0xE: return (nibThree == 0x9 && nibFour == 0xE) ? Op::OP_EX9E : Op::OP_EXA1;
+	case 0xF:
+		switch ((nibThree << 4) | nibFour)
+		{
+		case 0x07: return Op::OP_FX07;
+		case 0x0A: return Op::OP_FX0A;
+		case 0x15: return Op::OP_FX15;
+		case 0x18: return Op::OP_FX18;
+		case 0x1E: return Op::OP_FX1E;
+		case 0x29: return Op::OP_FX29;
+		case 0x33: return Op::OP_FX33;
+		case 0x55: return Op::OP_FX55;
+		case 0x65: return Op::OP_FX65;
+		}
+		return Op::NOP;
 	}
+	return Op::NOP;
+}
 
+namespace
+{
+	template <typename Table, typename Decoder>
+	constexpr Table makeDecodeTable(Decoder decoder)
+	{
+		Table table{};
+		for (std::size_t i{ 0 }; i < table.size(); ++i)
+		{
+			table[i] = decoder(static_cast<std::uint16_t>(i));
+		}
+		return table;
+	}
+}
+
+// Built entirely at compile time: one entry per possible 16-bit opcode
+constexpr std::array<Chip8::Op, 0x10000> Chip8::decodeTable{ makeDecodeTable<std::array<Chip8::Op, 0x10000>>(Chip8::decode) };
+
+// Must stay in the same order as Chip8::Op
+template<typename Quirks>
+constexpr Chip8::handler_table_type Chip8::handlerTable
+{
+	&Chip8::opcode_NOP,
+	&Chip8::opcode_00E0, &Chip8::opcode_00EE, &Chip8::opcode_1NNN, &Chip8::opcode_2NNN, &Chip8::opcode_3XNN,
+	&Chip8::opcode_4XNN, &Chip8::opcode_5XY0, &Chip8::opcode_6XNN, &Chip8::opcode_7XNN,
+	&Chip8::opcode_8XY0, &Chip8::opcode_8XY1, &Chip8::opcode_8XY2, &Chip8::opcode_8XY3, &Chip8::opcode_8XY4,
+	&Chip8::opcode_8XY5, &Chip8::opcode_8XY6<Quirks>, &Chip8::opcode_8XY7, &Chip8::opcode_8XYE<Quirks>,
+	&Chip8::opcode_9XY0, &Chip8::opcode_ANNN, &Chip8::opcode_BNNN<Quirks>, &Chip8::opcode_CXNN, &Chip8::opcode_DXYN,
+	&Chip8::opcode_EX9E, &Chip8::opcode_EXA1,
+	&Chip8::opcode_FX07, &Chip8::opcode_FX0A, &Chip8::opcode_FX15, &Chip8::opcode_FX18, &Chip8::opcode_FX1E,
+	&Chip8::opcode_FX29, &Chip8::opcode_FX33, &Chip8::opcode_FX55<Quirks>, &Chip8::opcode_FX65<Quirks>
+};
+
+template<typename Quirks>
+constexpr Chip8::Profile Chip8::makeProfile(Platform platform)
+{
+	return Profile
+	{
+		platform,
+		Quirks::jumpOffsetUsesX,
+		Quirks::shiftUsesY,
+		Quirks::loadStoreIncrementsIr,
+		&handlerTable<Quirks>,
+		&Chip8::dispatchSwitch<Quirks>,
+		&Chip8::runWith<Quirks>
+	};
+}
+
+// Must stay in the same order as Chip8::Platform
+const std::array<Chip8::Profile, 3> Chip8::profiles
+{
+	makeProfile<VipQuirks>(Platform::CosmacVip),
+	makeProfile<SuperChipQuirks>(Platform::SuperChip),
+	makeProfile<XoChipQuirks>(Platform::XoChip)
+};
+
+// Unrecognised opcode - ignored, as in dispatchSwitch()
+void Chip8::opcode_NOP(const Instruction&)
+{
 }
 
 // 00E0 - Clear display
-void Chip8::opcode_00E0()
+void Chip8::opcode_00E0(const Instruction&)
 {
+	// Rows that were already blank don't need redrawing
+	for (int y{ 0 }; y < DISPLAY_HEIGHT; ++y)
+	{
+		if (display[y] != 0) dirtyRows |= std::uint32_t{ 1 } << y;
+	}
+
 	display.fill(0);
 }
 
 // 00EE - Return to last address in stack
-void Chip8::opcode_00EE()
+void Chip8::opcode_00EE(const Instruction&)
 {
-	pc = stack.top();
-	stack.pop();
+	// Nothing to return to, so the ROM stays on this instruction like FX0A with no key held
+	if (sp == 0)
+	{
+		faultStack("Stack underflow");
+		pc -= 2;
+		return;
+	}
+	pc = stack[--sp];
 }
 
 // 1NNN - Jump
-void Chip8::opcode_1NNN()
+void Chip8::opcode_1NNN(const Instruction& inst)
 {
-	pc = (opcode & BITMASK_NNN);
+	pc = inst.nnn;
 }
 
 // 2NNN - Add to stack & Jump
-void Chip8::opcode_2NNN()
+void Chip8::opcode_2NNN(const Instruction& inst)
 {
-	stack.push(pc);
-	pc = (opcode & BITMASK_NNN);
+	// Some ROMs, INVADERS among them, leave a subroutine without returning now and then. Dropping the oldest entry,
+	// the one least likely to be returned to, keeps them running as an unbounded stack would.
+	if (sp == STACK_SIZE)
+	{
+		faultStack("Stack overflow");
+		std::copy(stack.begin() + 1, stack.end(), stack.begin());
+		--sp;
+	}
+	stack[sp++] = pc;
+	pc = inst.nnn;
 }
 
 // 3XNN - Skip if reg X == NN
-void Chip8::opcode_3XNN()
+void Chip8::opcode_3XNN(const Instruction& inst)
 {
-	int regVal{ registers[(opcode & BITMASK_X) >> 8] };
-	if (regVal == (opcode & BITMASK_NN)) pc += 2;
+	int regVal{ registers[inst.x] };
+	if (regVal == inst.nn) pc += 2;
 }
 
 // 4XNN - Skip if reg X != NN
-void Chip8::opcode_4XNN()
+void Chip8::opcode_4XNN(const Instruction& inst)
 {
-	int regVal{ registers[(opcode & BITMASK_X) >> 8] };
-	if (regVal != (opcode & BITMASK_NN)) pc += 2;
+	int regVal{ registers[inst.x] };
+	if (regVal != inst.nn) pc += 2;
 }
 
 // 5XY0 - Skip if reg X == reg Y
-void Chip8::opcode_5XY0()
+void Chip8::opcode_5XY0(const Instruction& inst)
 {
-	int regValX{ registers[(opcode & BITMASK_X) >> 8] };
-	int regValY{ registers[(opcode & BITMASK_Y) >> 4] };
+	int regValX{ registers[inst.x] };
+	int regValY{ registers[inst.y] };
 	if (regValX == regValY) pc += 2;
 }
 
 // 6XNN - Set reg X to NN
-void Chip8::opcode_6XNN()
+void Chip8::opcode_6XNN(const Instruction& inst)
 {
-	registers[(opcode & BITMASK_X) >> 8] = (opcode & BITMASK_NN);
+	registers[inst.x] = inst.nn;
 }
 
 // 7XNN - Add NN to reg X
-void Chip8::opcode_7XNN()
+void Chip8::opcode_7XNN(const Instruction& inst)
 {
-	registers[(opcode & BITMASK_X) >> 8] += (opcode & BITMASK_NN);
+	registers[inst.x] += inst.nn;
 }
 
 
 // 8XY0 - Set reg X to reg Y
-void Chip8::opcode_8XY0()
+void Chip8::opcode_8XY0(const Instruction& inst)
 {
-	registers[(opcode & BITMASK_X) >> 8] = registers[(opcode & BITMASK_Y) >> 4];
+	registers[inst.x] = registers[inst.y];
 }
 
 // 8XY1 - Logical OR
-void Chip8::opcode_8XY1()
+void Chip8::opcode_8XY1(const Instruction& inst)
 {
-	registers[(opcode & BITMASK_X) >> 8] |= registers[(opcode & BITMASK_Y) >> 4];
+	registers[inst.x] |= registers[inst.y];
 }
 
 // 8XY2 - Logical AND
-void Chip8::opcode_8XY2()
+void Chip8::opcode_8XY2(const Instruction& inst)
 {
-	registers[(opcode & BITMASK_X) >> 8] &= registers[(opcode & BITMASK_Y) >> 4];
+	registers[inst.x] &= registers[inst.y];
 }
 
 // 8XY3 - Logical XOR
-void Chip8::opcode_8XY3()
+void Chip8::opcode_8XY3(const Instruction& inst)
 {
-	registers[(opcode & BITMASK_X) >> 8] ^= registers[(opcode & BITMASK_Y) >> 4];
+	registers[inst.x] ^= registers[inst.y];
 }
 
 // 8XY4 - Add
-void Chip8::opcode_8XY4()
+void Chip8::opcode_8XY4(const Instruction& inst)
 {
-	int result{ registers[(opcode & BITMASK_X) >> 8] + registers[(opcode & BITMASK_Y) >> 4] };
+	int result{ registers[inst.x] + registers[inst.y] };
 	registers[0xF] = (result > 255);
-	registers[(opcode & BITMASK_X) >> 8] = static_cast<std::uint8_t>(result);
+	registers[inst.x] = static_cast<std::uint8_t>(result);
 }
 
 
 // 8XY5 - X subtract Y
-void Chip8::opcode_8XY5()
+void Chip8::opcode_8XY5(const Instruction& inst)
 {
-	int regX{ (opcode & BITMASK_X) >> 8 };
-	int regY{ (opcode & BITMASK_Y) >> 4 };
+	int regX{ inst.x };
+	int regY{ inst.y };
 	registers[0xF] = (registers[regX] > registers[regY]);
 	registers[regX] -= registers[regY];
 }
 
 // 8XY6 - Shift Right
-void Chip8::opcode_8XY6()
+template<typename Quirks>
+void Chip8::opcode_8XY6(const Instruction& inst)
 {
-	int regX{ (opcode & BITMASK_X) >> 8 };
+	int regX{ inst.x };
 
-	if (altShrShl)
+	if constexpr (Quirks::shiftUsesY)
 	{
-		registers[regX] = registers[(opcode & BITMASK_Y) >> 4];
+		registers[regX] = registers[inst.y];
 	}
 
 	registers[0xF] = registers[regX] & 0x1;
@@ -310,22 +1021,23 @@ void Chip8::opcode_8XY6()
 }
 
 // 8XY7 - Y subtract X
-void Chip8::opcode_8XY7()
+void Chip8::opcode_8XY7(const Instruction& inst)
 {
-	int regX{ (opcode & BITMASK_X) >> 8 };
-	int regY{ (opcode & BITMASK_Y) >> 4 };
+	int regX{ inst.x };
+	int regY{ inst.y };
 	registers[0xF] = (registers[regY] > registers[regX]);
-	registers[regY] -= registers[regX];
+	registers[regX] = static_cast<std::uint8_t>(registers[regY] - registers[regX]);
 }
 
 // 8XYE - Shift Left
-void Chip8::opcode_8XYE()
+template<typename Quirks>
+void Chip8::opcode_8XYE(const Instruction& inst)
 {
-	int regX{ (opcode & BITMASK_X) >> 8 };
+	int regX{ inst.x };
 
-	if (altShrShl)
+	if constexpr (Quirks::shiftUsesY)
 	{
-		registers[regX] = registers[(opcode & BITMASK_Y) >> 4];
+		registers[regX] = registers[inst.y];
 	}
 
 	registers[0xF] = (registers[regX] & 0x80) >> 7;
@@ -334,137 +1046,144 @@ void Chip8::opcode_8XYE()
 
 
 // 9XY0 = Skip if reg X != reg Y
-void Chip8::opcode_9XY0()
+void Chip8::opcode_9XY0(const Instruction& inst)
 {
-	int regValX{ registers[(opcode & BITMASK_X) >> 8] };
-	int regValY{ registers[(opcode & BITMASK_Y) >> 4] };
+	int regValX{ registers[inst.x] };
+	int regValY{ registers[inst.y] };
 	if (regValX != regValY) pc += 2;
 }
 
 // ANNN - Set index reg to NNN
-void Chip8::opcode_ANNN()
+void Chip8::opcode_ANNN(const Instruction& inst)
 {
-	ir = (opcode & BITMASK_NNN);
+	ir = inst.nnn;
 }
 
 // BNNN - Jump with offset
-void Chip8::opcode_BNNN()
+template<typename Quirks>
+void Chip8::opcode_BNNN(const Instruction& inst)
 {
-	if (altJumpOffset)
+	if constexpr (Quirks::jumpOffsetUsesX)
 	{
-		pc = (opcode & BITMASK_NNN) + registers[(opcode & BITMASK_X) >> 8];
+		pc = inst.nnn + registers[inst.x];
 	}
 	else
 	{
-		pc = (opcode & BITMASK_NNN) + registers[0];
+		pc = inst.nnn + registers[0];
 	}
 }
 
 // CXNN - Generate random number
-void Chip8::opcode_CXNN()
+void Chip8::opcode_CXNN(const Instruction& inst)
 {
-	registers[(opcode & BITMASK_X) >> 8] = (opcode & BITMASK_NN) & intRng(rngEngine);
+	registers[inst.x] = inst.nn & rng.nextByte();
 }
 
 // DXYN - Display to screen
-void Chip8::opcode_DXYN()
+void Chip8::opcode_DXYN(const Instruction& inst)
 {
-	int xCoord{ registers[(opcode & BITMASK_X) >> 8] % DISPLAY_WIDTH };
-	int yCoord{ registers[(opcode & BITMASK_Y) >> 4] % DISPLAY_HEIGHT };
+	static_assert(DISPLAY_WIDTH == 64, "Each framebuffer row must be one uint64_t");
+	static_assert(DISPLAY_HEIGHT <= 32, "Each framebuffer row needs a bit in dirtyRows");
+
+	int xCoord{ registers[inst.x] % DISPLAY_WIDTH };
+	int yCoord{ registers[inst.y] % DISPLAY_HEIGHT };
 	registers[0xF] = 0;
 
-	for (int row{ 0 }; row < (opcode & BITMASK_N); ++row)
+	for (int row{ 0 }; row < inst.n; ++row)
 	{
-		std::uint8_t spriteData{ memory[ir + row] };
+		// Sprites are clipped at the bottom and right edges rather than drawn past the display
+		if (yCoord + row >= DISPLAY_HEIGHT) break;
 
-		for (int col{ 0 }; col < 8; ++col)
+		// Line the sprite byte up with its columns, pixels past the right edge are shifted out
+		std::uint64_t spriteRow{ (static_cast<std::uint64_t>(memory[ir + row]) << 56) >> xCoord };
+		std::uint64_t& displayRow{ display[yCoord + row] };
+
+		if (displayRow & spriteRow)
 		{
-			if (spriteData & (0x80 >> col)) // Check each pixel (bit) and see if on (1)
-			{
-				// Get specific display pixel for this sprite pixel
-				int displayIndex{ ((yCoord + row) * DISPLAY_WIDTH) + (xCoord + col) };
-
-				if (display[displayIndex] == 0xFFFFFFFF)
-				{
-					registers[0xF] = 1;
-				}
-
-				display[displayIndex] ^= 0xFFFFFFFF;
-			}
+			registers[0xF] = 1;
 		}
+		CHIP8_PROFILE_ONLY(executionProfile.pixelsDrawn += std::bitset<64>{ spriteRow }.count());
+		CHIP8_PROFILE_ONLY(executionProfile.pixelsErased += std::bitset<64>{ displayRow & spriteRow }.count());
+
+		displayRow ^= spriteRow;
+		if (spriteRow != 0) dirtyRows |= std::uint32_t{ 1 } << (yCoord + row);
 	}
+
+	CHIP8_PROFILE_ONLY(executionProfile.collisions += registers[0xF]);
 }
 
 // EX9E - Skip on key press
-void Chip8::opcode_EX9E()
+void Chip8::opcode_EX9E(const Instruction& inst)
 {
-	if (keypad[registers[(opcode & BITMASK_X) >> 8]])
+	if (keypad[registers[inst.x]])
 	{
 		pc += 2;
 	}
 }
 
 // EXA1 - Skip on no key press
-void Chip8::opcode_EXA1()
+void Chip8::opcode_EXA1(const Instruction& inst)
 {
-	if (!keypad[registers[(opcode & BITMASK_X) >> 8]])
+	if (!keypad[registers[inst.x]])
 	{
 		pc += 2;
 	}
 }
 
 // FX07 - Get delay timer
-void Chip8::opcode_FX07()
+void Chip8::opcode_FX07(const Instruction& inst)
 {
-	registers[(opcode & BITMASK_X) >> 8] = delayTimer;
+	registers[inst.x] = delayTimer;
 }
 
 // FX0A - Get key input
-void Chip8::opcode_FX0A()
+void Chip8::opcode_FX0A(const Instruction& inst)
 {
 	auto keyPressed{ std::find(keypad.begin(), keypad.end(), 1) };
-	if (keyPressed == keypad.end())
+	waitingForKey = (keyPressed == keypad.end());
+	if (waitingForKey)
 	{
 		pc -= 2;
+		CHIP8_PROFILE_ONLY(++executionProfile.keyWaitInstructions);
 	}
 	else
 	{
-		registers[(opcode & BITMASK_X) >> 8] = static_cast<std::uint8_t>(std::distance(keypad.begin(), keyPressed));
+		registers[inst.x] = static_cast<std::uint8_t>(std::distance(keypad.begin(), keyPressed));
 	}
 }
 
 // FX15 - Set delay timer
-void Chip8::opcode_FX15()
+void Chip8::opcode_FX15(const Instruction& inst)
 {
-	delayTimer = registers[(opcode & BITMASK_X) >> 8];
+	delayTimer = registers[inst.x];
 }
 
 // FX18 - Set sound timer
-void Chip8::opcode_FX18()
+void Chip8::opcode_FX18(const Instruction& inst)
 {
-	soundTimer = registers[(opcode & BITMASK_X) >> 8];
+	soundTimer = registers[inst.x];
 }
 
 // FX1E - Add to index
-void Chip8::opcode_FX1E()
+void Chip8::opcode_FX1E(const Instruction& inst)
 {
-	int result{ ir + registers[(opcode & BITMASK_X) >> 8] };
+	int result{ ir + registers[inst.x] };
 	registers[0xF] = (result > 0xFFF);
 
 	ir = static_cast<std::uint16_t>(result);
 }
 
 // FX29 - Get font char
-void Chip8::opcode_FX29()
+void Chip8::opcode_FX29(const Instruction& inst)
 {
-	std::uint8_t fontChar = registers[(opcode & BITMASK_X) >> 8];
+	std::uint8_t fontChar = registers[inst.x];
 	ir = FONTCHAR_START + (5 * fontChar);
 }
 
 // FX33 - Bin to Dec conversion
-void Chip8::opcode_FX33()
+void Chip8::opcode_FX33(const Instruction& inst)
 {
-	int number = registers[(opcode & BITMASK_X) >> 8];
+	int number = registers[inst.x];
 
 	memory[ir + 2] = number % 10;
 	number /= 10;
@@ -473,27 +1192,42 @@ void Chip8::opcode_FX33()
 	number /= 10;
 
 	memory[ir] = number % 10;
+
+	invalidateDecoded(ir, 3);
 }
 
 // FX55 - Store mem
-void Chip8::opcode_FX55()
+template<typename Quirks>
+void Chip8::opcode_FX55(const Instruction& inst)
 {
-	int regX{ (opcode & BITMASK_X) >> 8 };
+	int regX{ inst.x };
 
 	for (int i{ 0 }; i <= regX; ++i)
 	{
 		memory[ir + i] = registers[i];
 	}
 
+	invalidateDecoded(ir, regX + 1);
+
+	if constexpr (Quirks::loadStoreIncrementsIr)
+	{
+		ir = static_cast<std::uint16_t>(ir + regX + 1);
+	}
 }
 
 // FX65 - Load mem
-void Chip8::opcode_FX65()
+template<typename Quirks>
+void Chip8::opcode_FX65(const Instruction& inst)
 {
-	int regX{ (opcode & BITMASK_X) >> 8 };
+	int regX{ inst.x };
 
 	for (int i{ 0 }; i <= regX; ++i)
 	{
 		registers[i] = memory[ir + i];
 	}
+
+	if constexpr (Quirks::loadStoreIncrementsIr)
+	{
+		ir = static_cast<std::uint16_t>(ir + regX + 1);
+	}
 }
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "Chip8Aot.h"
+
+#include <algorithm>
+#include <cstring>
+
+Chip8Aot::Chip8Aot(Chip8& chip8, const Program& program)
+	: chip8{ chip8 },
+	program{ program },
+	machine{ chip8.registers, chip8.ir, chip8.pc, chip8.delayTimer, chip8.soundTimer, *this }
+{
+	// Quirks were resolved when the program was generated
+	chip8.setPlatform(program.platform);
+
+	for (std::size_t i{ 0 }; i < program.blockCount; ++i)
+	{
+		const Block& block{ program.blocks[i] };
+		for (std::size_t j{ block.start }; j < block.end; ++j) codeBytes[j] = true;
+	}
+	revalidate();
+}
+
+void Chip8Aot::revalidate()
+{
+	entries.fill(nullptr);
+	for (std::size_t i{ 0 }; i < program.blockCount; ++i)
+	{
+		const Block& block{ program.blocks[i] };
+		if (matchesRom(block)) entries[block.start] = &block;
+	}
+}
+
+// A block is only valid while the memory it was compiled from is unchanged
+bool Chip8Aot::matchesRom(const Block& block) const
+{
+	if (block.start < ROM_START || block.end > ROM_START + program.romSize) return false;
+
+	return std::memcmp(&chip8.memory[block.start], &program.rom[block.start - ROM_START], block.end - block.start) == 0;
+}
+
+void Chip8Aot::memoryWritten(std::size_t address, std::size_t length)
+{
+	std::size_t last{ std::min(address + length, Chip8::MEMORY_SIZE) };
+
+	bool touched{ false };
+	for (std::size_t i{ address }; i < last; ++i)
+	{
+		if (codeBytes[i])
+		{
+			touched = true;
+			break;
+		}
+	}
+	if (!touched) return;
+
+	// Writing the original bytes back re-enables a block
+	for (std::size_t i{ 0 }; i < program.blockCount; ++i)
+	{
+		const Block& block{ program.blocks[i] };
+		if (block.start < last && address < block.end)
+		{
+			entries[block.start] = matchesRom(block) ? &block : nullptr;
+		}
+	}
+}
+
+void Chip8Aot::run(std::size_t instructions)
+{
+	std::size_t executed{ 0 };
+
+	while (executed < instructions)
+	{
+		const Block* block{ (chip8.pc < Chip8::MEMORY_SIZE) ? entries[chip8.pc] : nullptr };
+
+		if (!block || block->length > instructions - executed)
+		{
+			stepInterpreter();
+			++executed;
+			continue;
+		}
+
+		// Timer instructions always end a block, so every tick can be applied up front
+		chip8.tickTimers(block->length);
+		chip8.instructionCount += block->length;
+		block->code(machine);
+		executed += block->length;
+	}
+}
+
+void Chip8Aot::stepInterpreter()
+{
+	std::uint16_t pc{ chip8.pc };
+	Chip8::Op op{ Chip8::Op::NOP };
+	if (pc <= Chip8::MEMORY_SIZE - 2)
+	{
+		op = Chip8::decodeTable[(chip8.memory[pc] << 8) | chip8.memory[pc + 1]];
+	}
+	std::uint8_t x{ static_cast<std::uint8_t>(chip8.memory[pc & 0xFFF] & 0x0F) };
+	std::uint16_t ir{ chip8.ir };	// FX55 may move I past what it wrote
+
+	chip8.cycle();
+
+	if (op == Chip8::Op::OP_FX33) memoryWritten(ir, 3);
+	if (op == Chip8::Op::OP_FX55) memoryWritten(ir, x + 1);
+}
+
+void Chip8Aot::callHandler(std::uint16_t opcode, std::uint16_t nextPc)
+{
+	Chip8::Instruction inst{ Chip8::decodeInstruction(opcode) };
+	std::uint16_t ir{ chip8.ir };
+	chip8.pc = nextPc;
+	(chip8.*(*chip8.profile->handlers)[static_cast<std::size_t>(inst.op)])(inst);
+
+	if (inst.op == Chip8::Op::OP_FX33) memoryWritten(ir, 3);
+	if (inst.op == Chip8::Op::OP_FX55) memoryWritten(ir, inst.x + 1);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Chip8.h"
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+// Runs a ROM that was translated ahead of time to C++ by the Chip8-AOT tool.
+// Addresses that have no compiled block, or whose code no longer matches the ROM, go through Chip8::cycle().
+class Chip8Aot
+{
+public:
+	// Machine state handed to compiled blocks
+	struct Machine
+	{
+		std::array<std::uint8_t, 16>& registers;
+		std::uint16_t& ir;
+		std::uint16_t& pc;
+		std::uint8_t& delayTimer;
+		std::uint8_t& soundTimer;
+		Chip8Aot& runtime;
+
+		// Run an instruction through its interpreter handler, with pc already past it
+		void call(std::uint16_t opcode, std::uint16_t nextPc)
+		{
+			runtime.callHandler(opcode, nextPc);
+		}
+	};
+
+	using block_fn = void (*)(Machine&);
+
+	struct Block
+	{
+		std::uint16_t start;		// First byte covered
+		std::uint16_t end;			// One past the last byte covered
+		std::uint32_t length;		// Instructions in block
+		block_fn code;
+	};
+
+	// Emitted by Chip8-AOT, one per ROM
+	struct Program
+	{
+		const char* name;
+		Chip8::Platform platform;	// Quirks the blocks were compiled with
+		const std::uint8_t* rom;	// ROM image the blocks were compiled from, loaded at 0x200
+		std::size_t romSize;
+		const Block* blocks;
+		std::size_t blockCount;
+	};
+
+	Chip8Aot(Chip8& chip8, const Program& program);
+
+	Chip8Aot(const Chip8Aot&) = delete;
+	Chip8Aot& operator=(const Chip8Aot&) = delete;
+
+	// Execute the given number of instructions
+	void run(std::size_t instructions);
+
+	// Re-check every block against memory, must be called after loading a ROM
+	void revalidate();
+
+private:
+	static constexpr std::size_t ROM_START{ 0x200 };
+
+	Chip8& chip8;
+	const Program& program;
+	Machine machine;
+
+	std::array<const Block*, Chip8::MEMORY_SIZE> entries{};
+	std::bitset<Chip8::MEMORY_SIZE> codeBytes{};	// Bytes read by any compiled block
+
+	bool matchesRom(const Block& block) const;
+	void memoryWritten(std::size_t address, std::size_t length);
+	void stepInterpreter();
+	void callHandler(std::uint16_t opcode, std::uint16_t nextPc);
+};
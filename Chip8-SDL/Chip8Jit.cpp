@@ -0,0 +1,740 @@
+#include "Chip8Jit.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHIP8_JIT_X64
+#endif
+
+#if defined(CHIP8_JIT_X64)
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+namespace
+{
+	enum Reg : int
+	{
+		RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+		R8, R9, R10, R11, R12, R13, R14, R15
+	};
+
+	enum Cond : std::uint8_t
+	{
+		COND_E = 0x4,
+		COND_NE = 0x5,
+		COND_A = 0x7
+	};
+
+	// Register roles inside a block:
+	//   rbx	- base address of the Chip8 instance, every field is addressed as [rbx + disp32]
+	//   r12d	- index register
+	//   eax, ecx, edx - scratch
+	//   the rest of the callee-saved registers hold the most used V registers of the block
+#if defined(_WIN32)
+	constexpr Reg ARG0{ RCX };
+	constexpr Reg ARG1{ RDX };
+	constexpr std::uint8_t SHADOW_SPACE{ 32 };
+	constexpr std::array<Reg, 8> SAVED_REGS{ RBX, RBP, RSI, RDI, R12, R13, R14, R15 };
+	constexpr std::array<Reg, 6> CACHE_REGS{ RBP, RSI, RDI, R13, R14, R15 };
+#else
+	constexpr Reg ARG0{ RDI };
+	constexpr Reg ARG1{ RSI };
+	constexpr std::uint8_t SHADOW_SPACE{ 0 };
+	constexpr std::array<Reg, 6> SAVED_REGS{ RBX, RBP, R12, R13, R14, R15 };
+	constexpr std::array<Reg, 4> CACHE_REGS{ RBP, R13, R14, R15 };
+#endif
+	constexpr Reg BASE{ RBX };
+	constexpr Reg IR{ R12 };
+
+	// Minimal x86-64 encoder, only covers the forms the translator needs
+	class Assembler
+	{
+	public:
+		std::vector<std::uint8_t> code{};
+
+		void byte(std::uint8_t b)
+		{
+			code.push_back(b);
+		}
+
+		void imm16(std::uint16_t v)
+		{
+			byte(v & 0xFF);
+			byte(v >> 8);
+		}
+
+		void imm32(std::uint32_t v)
+		{
+			for (int i{ 0 }; i < 4; ++i) byte((v >> (8 * i)) & 0xFF);
+		}
+
+		void imm64(std::uint64_t v)
+		{
+			for (int i{ 0 }; i < 8; ++i) byte((v >> (8 * i)) & 0xFF);
+		}
+
+		void rex(bool w, int reg, int rm)
+		{
+			std::uint8_t prefix{ static_cast<std::uint8_t>(0x40 | (w << 3) | ((reg >= 8) << 2) | (rm >= 8)) };
+			if (prefix != 0x40) byte(prefix);
+		}
+
+		void modrm(int mod, int reg, int rm)
+		{
+			byte(static_cast<std::uint8_t>((mod << 6) | ((reg & 7) << 3) | (rm & 7)));
+		}
+
+		// [rbx + disp32]
+		void memBase(int reg, std::int32_t disp)
+		{
+			modrm(2, reg, BASE);
+			imm32(static_cast<std::uint32_t>(disp));
+		}
+
+		void push(Reg r)				{ rex(false, 0, r); byte(0x50 + (r & 7)); }
+		void pop(Reg r)					{ rex(false, 0, r); byte(0x58 + (r & 7)); }
+		void ret()						{ byte(0xC3); }
+		void subRsp(std::uint8_t n)		{ byte(0x48); byte(0x83); byte(0xEC); byte(n); }
+		void addRsp(std::uint8_t n)		{ byte(0x48); byte(0x83); byte(0xC4); byte(n); }
+		void callReg(Reg r)				{ rex(false, 0, r); byte(0xFF); modrm(3, 2, r); }
+
+		void movImm32(Reg dst, std::uint32_t v)	{ rex(false, 0, dst); byte(0xB8 + (dst & 7)); imm32(v); }
+		void movImm64(Reg dst, std::uint64_t v)	{ rex(true, 0, dst); byte(0xB8 + (dst & 7)); imm64(v); }
+		void mov32(Reg dst, Reg src)			{ rex(false, src, dst); byte(0x89); modrm(3, src, dst); }
+
+		// add 01, or 09, and 21, sub 29, xor 31, cmp 39
+		void alu32(std::uint8_t opc, Reg dst, Reg src)	{ rex(false, src, dst); byte(opc); modrm(3, src, dst); }
+
+		// add /0, or /1, and /4, sub /5, xor /6, cmp /7
+		void aluImm32(int digit, Reg dst, std::uint32_t v)	{ rex(false, 0, dst); byte(0x81); modrm(3, digit, dst); imm32(v); }
+
+		// shl /4, shr /5
+		void shiftImm(int digit, Reg dst, std::uint8_t n)	{ rex(false, 0, dst); byte(0xC1); modrm(3, digit, dst); byte(n); }
+
+		void imulImm8(Reg dst, Reg src, std::uint8_t v)	{ rex(false, dst, src); byte(0x6B); modrm(3, dst, src); byte(v); }
+
+		// Source must be al, cl or dl
+		void movzx8(Reg dst, Reg src)	{ rex(false, dst, src); byte(0x0F); byte(0xB6); modrm(3, dst, src); }
+		void movzx16(Reg dst, Reg src)	{ rex(false, dst, src); byte(0x0F); byte(0xB7); modrm(3, dst, src); }
+
+		// Destination must be al, cl or dl
+		void setcc(Cond cc, Reg dst)			{ byte(0x0F); byte(0x90 + cc); modrm(3, 0, dst); }
+		void cmovcc(Cond cc, Reg dst, Reg src)	{ rex(false, dst, src); byte(0x0F); byte(0x40 + cc); modrm(3, dst, src); }
+
+		void loadMem8(Reg dst, std::int32_t disp)	{ rex(false, dst, BASE); byte(0x0F); byte(0xB6); memBase(dst, disp); }
+		void loadMem16(Reg dst, std::int32_t disp)	{ rex(false, dst, BASE); byte(0x0F); byte(0xB7); memBase(dst, disp); }
+
+		// Source must be al, cl or dl
+		void storeMem8(std::int32_t disp, Reg src)			{ byte(0x88); memBase(src, disp); }
+		void storeMem8Imm(std::int32_t disp, std::uint8_t v)	{ byte(0xC6); memBase(0, disp); byte(v); }
+		void storeMem16(std::int32_t disp, Reg src)			{ byte(0x66); rex(false, src, BASE); byte(0x89); memBase(src, disp); }
+		void storeMem16Imm(std::int32_t disp, std::uint16_t v)	{ byte(0x66); byte(0xC7); memBase(0, disp); imm16(v); }
+	};
+
+	enum class Kind
+	{
+		Native,				// Translated inline
+		NativeTerminator,	// Translated inline, ends the block
+		Helper,				// Calls the interpreter's handler
+		HelperTerminator	// Calls the interpreter's handler, ends the block
+	};
+}
+
+Chip8Jit::Chip8Jit(Chip8& chip8)
+	: chip8{ chip8 }
+{
+#if defined(CHIP8_JIT_X64)
+#if defined(_WIN32)
+	void* memory{ VirtualAlloc(nullptr, CODE_BUFFER_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE) };
+#else
+	void* memory{ mmap(nullptr, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) };
+	if (memory == MAP_FAILED) memory = nullptr;
+#endif
+	codeBuffer = static_cast<std::uint8_t*>(memory);
+#endif
+}
+
+Chip8Jit::~Chip8Jit()
+{
+#if defined(CHIP8_JIT_X64)
+	if (codeBuffer)
+	{
+#if defined(_WIN32)
+		VirtualFree(codeBuffer, 0, MEM_RELEASE);
+#else
+		munmap(codeBuffer, CODE_BUFFER_SIZE);
+#endif
+	}
+#endif
+}
+
+bool Chip8Jit::isSupported()
+{
+#if defined(CHIP8_JIT_X64)
+	return true;
+#else
+	return false;
+#endif
+}
+
+void Chip8Jit::flush()
+{
+	blocks.clear();
+	helperSites.clear();
+	entries.fill(nullptr);
+	codeBytes.reset();
+	codeUsed = 0;
+}
+
+// The buffer is never writable and executable at once: compile() switches it to read+write before copying a block
+// in, run() switches it back to read+execute before calling one
+bool Chip8Jit::setExecutable(bool executable)
+{
+	if (executable == codeExecutable) return true;
+
+#if defined(CHIP8_JIT_X64)
+#if defined(_WIN32)
+	DWORD previous{};
+	if (!VirtualProtect(codeBuffer, CODE_BUFFER_SIZE, executable ? PAGE_EXECUTE_READ : PAGE_READWRITE, &previous)) return false;
+	if (executable) FlushInstructionCache(GetCurrentProcess(), codeBuffer, CODE_BUFFER_SIZE);
+#else
+	if (mprotect(codeBuffer, CODE_BUFFER_SIZE, executable ? (PROT_READ | PROT_EXEC) : (PROT_READ | PROT_WRITE)) != 0) return false;
+#endif
+#endif
+
+	codeExecutable = executable;
+	return true;
+}
+
+void Chip8Jit::setLockstep(bool enabled)
+{
+	reference = enabled ? std::make_unique<Chip8>(chip8) : nullptr;
+	diverged = false;
+}
+
+std::size_t Chip8Jit::run(std::size_t instructions)
+{
+	std::size_t executed{ 0 };
+
+	while (executed < instructions && !diverged)
+	{
+		std::uint16_t pc{ chip8.pc };
+		Block* block{ nullptr };
+
+		if (codeBuffer && pc <= Chip8::MEMORY_SIZE - 2)
+		{
+			block = entries[pc];
+			if (!block) block = compile(pc);
+		}
+
+		if (!block || block->length > instructions - executed || !setExecutable(true))
+		{
+			stepInterpreter();
+			++executed;
+			if (reference)
+			{
+				reference->cycle();
+				checkLockstep(pc, 1);
+			}
+		}
+		else
+		{
+			// Timer instructions always end a block, so every tick can be applied up front
+			chip8.tickTimers(block->length);
+			chip8.instructionCount += block->length;
+			block->code();
+			executed += block->length;
+
+			if (reference)
+			{
+				for (std::uint32_t i{ 0 }; i < block->length; ++i) reference->cycle();
+				checkLockstep(block->start, block->length);
+			}
+		}
+
+		if (chip8.waitingForKey && executed < instructions && !diverged) executed += waitForKey(instructions - executed);
+	}
+
+	return executed;
+}
+
+// FX0A with no key held runs again and again without changing anything but the timers, so the rest of the budget is
+// counted at once like Chip8::run() does, instead of going back through the block lookup for every repeat
+std::size_t Chip8Jit::waitForKey(std::size_t instructions)
+{
+	std::uint16_t pc{ chip8.pc };
+	chip8.tickTimers(instructions);
+	chip8.instructionCount += instructions;
+
+	if (reference)
+	{
+		for (std::size_t i{ 0 }; i < instructions; ++i) reference->cycle();
+		checkLockstep(pc, static_cast<std::uint32_t>(instructions));
+	}
+	return instructions;
+}
+
+void Chip8Jit::stepInterpreter()
+{
+	std::uint16_t pc{ chip8.pc };
+	Chip8::Op op{ Chip8::Op::NOP };
+	if (pc <= Chip8::MEMORY_SIZE - 2)
+	{
+		op = Chip8::decodeTable[(chip8.memory[pc] << 8) | chip8.memory[pc + 1]];
+	}
+	std::uint8_t x{ static_cast<std::uint8_t>(chip8.memory[pc & 0xFFF] & 0x0F) };
+	std::uint16_t ir{ chip8.ir };	// FX55 may move I past what it wrote
+
+	chip8.cycle();
+
+	if (op == Chip8::Op::OP_FX33) invalidate(ir, 3);
+	if (op == Chip8::Op::OP_FX55) invalidate(ir, x + 1);
+}
+
+void Chip8Jit::callHandler(Chip8Jit* jit, const HelperSite* site)
+{
+	Chip8& chip8{ jit->chip8 };
+	std::uint16_t ir{ chip8.ir };
+	chip8.pc = site->nextPc;
+	(chip8.*(*chip8.profile->handlers)[static_cast<std::size_t>(site->inst.op)])(site->inst);
+
+	if (site->inst.op == Chip8::Op::OP_FX33) jit->invalidate(ir, 3);
+	if (site->inst.op == Chip8::Op::OP_FX55) jit->invalidate(ir, site->inst.x + 1);
+}
+
+// Unlink every block that reads a byte in [address, address + length)
+void Chip8Jit::invalidate(std::size_t address, std::size_t length)
+{
+	std::size_t last{ std::min(address + length, Chip8::MEMORY_SIZE) };
+
+	bool touched{ false };
+	for (std::size_t i{ address }; i < last; ++i)
+	{
+		if (codeBytes[i])
+		{
+			touched = true;
+			break;
+		}
+	}
+	if (!touched) return;
+
+	codeBytes.reset();
+	for (Block*& entry : entries)
+	{
+		if (!entry) continue;
+
+		if (entry->start < last && address < entry->end)
+		{
+			entry = nullptr;
+			continue;
+		}
+		for (std::size_t i{ entry->start }; i < entry->end; ++i) codeBytes[i] = true;
+	}
+}
+
+Chip8Jit::Block* Chip8Jit::compile(std::uint16_t address)
+{
+#if defined(CHIP8_JIT_X64)
+	auto offsetOf = [this](const void* field)
+	{
+		return static_cast<std::int32_t>(static_cast<const std::uint8_t*>(field) - reinterpret_cast<const std::uint8_t*>(&chip8));
+	};
+	const std::int32_t offRegisters{ offsetOf(chip8.registers.data()) };
+	const std::int32_t offIr{ offsetOf(&chip8.ir) };
+	const std::int32_t offPc{ offsetOf(&chip8.pc) };
+	const std::int32_t offDelay{ offsetOf(&chip8.delayTimer) };
+	const std::int32_t offSound{ offsetOf(&chip8.soundTimer) };
+
+	auto classify = [](Chip8::Op op)
+	{
+		switch (op)
+		{
+		case Chip8::Op::OP_1NNN:
+		case Chip8::Op::OP_3XNN:
+		case Chip8::Op::OP_4XNN:
+		case Chip8::Op::OP_5XY0:
+		case Chip8::Op::OP_9XY0:
+		case Chip8::Op::OP_FX07:
+		case Chip8::Op::OP_FX15:
+		case Chip8::Op::OP_FX18:
+			return Kind::NativeTerminator;
+		case Chip8::Op::OP_00E0:
+		case Chip8::Op::OP_CXNN:
+		case Chip8::Op::OP_DXYN:
+		case Chip8::Op::OP_FX65:
+			return Kind::Helper;
+		case Chip8::Op::OP_00EE:
+		case Chip8::Op::OP_2NNN:
+		case Chip8::Op::OP_BNNN:
+		case Chip8::Op::OP_EX9E:
+		case Chip8::Op::OP_EXA1:
+		case Chip8::Op::OP_FX0A:
+		case Chip8::Op::OP_FX33:
+		case Chip8::Op::OP_FX55:
+			return Kind::HelperTerminator;
+		default:
+			return Kind::Native;
+		}
+	};
+
+	// Scan the block
+	std::vector<Chip8::Instruction> insts{};
+	std::uint16_t pc{ address };
+	while (insts.size() < MAX_BLOCK_LENGTH && pc <= Chip8::MEMORY_SIZE - 2)
+	{
+		Chip8::Instruction inst{ Chip8::decodeInstruction(static_cast<std::uint16_t>((chip8.memory[pc] << 8) | chip8.memory[pc + 1])) };
+		insts.push_back(inst);
+		pc += 2;
+
+		Kind kind{ classify(inst.op) };
+		if (kind == Kind::NativeTerminator || kind == Kind::HelperTerminator) break;
+	}
+
+	// Keep the most referenced V registers in host registers
+	auto referenced = [this](const Chip8::Instruction& inst) -> std::uint16_t
+	{
+		const std::uint16_t vx{ static_cast<std::uint16_t>(1 << inst.x) };
+		const std::uint16_t vy{ static_cast<std::uint16_t>(1 << inst.y) };
+		const std::uint16_t vf{ 1 << 0xF };
+
+		switch (inst.op)
+		{
+		case Chip8::Op::OP_3XNN:
+		case Chip8::Op::OP_4XNN:
+		case Chip8::Op::OP_6XNN:
+		case Chip8::Op::OP_7XNN:
+		case Chip8::Op::OP_FX07:
+		case Chip8::Op::OP_FX15:
+		case Chip8::Op::OP_FX18:
+		case Chip8::Op::OP_FX29:
+			return vx;
+		case Chip8::Op::OP_5XY0:
+		case Chip8::Op::OP_9XY0:
+		case Chip8::Op::OP_8XY0:
+		case Chip8::Op::OP_8XY1:
+		case Chip8::Op::OP_8XY2:
+		case Chip8::Op::OP_8XY3:
+			return vx | vy;
+		case Chip8::Op::OP_8XY4:
+		case Chip8::Op::OP_8XY5:
+		case Chip8::Op::OP_8XY7:
+			return vx | vy | vf;
+		case Chip8::Op::OP_8XY6:
+		case Chip8::Op::OP_8XYE:
+			return vx | vf | (chip8.profile->shiftUsesY ? vy : 0);
+		case Chip8::Op::OP_FX1E:
+			return vx | vf;
+		default:
+			return 0;
+		}
+	};
+
+	std::array<int, 16> uses{};
+	for (const Chip8::Instruction& inst : insts)
+	{
+		std::uint16_t mask{ referenced(inst) };
+		for (int v{ 0 }; v < 16; ++v)
+		{
+			if (mask & (1 << v)) ++uses[v];
+		}
+	}
+	std::array<int, 16> order{};
+	for (int i{ 0 }; i < 16; ++i) order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&uses](int a, int b) { return uses[a] > uses[b]; });
+
+	std::array<int, 16> hostReg{};
+	hostReg.fill(-1);
+	std::vector<int> cached{};
+	for (int v : order)
+	{
+		if (cached.size() == CACHE_REGS.size() || uses[v] < 2) break;
+		hostReg[v] = CACHE_REGS[cached.size()];
+		cached.push_back(v);
+	}
+	std::uint16_t dirty{ 0 };
+
+	Assembler a{};
+
+	auto loadV = [&](Reg dst, int v)
+	{
+		if (hostReg[v] >= 0) a.mov32(dst, static_cast<Reg>(hostReg[v]));
+		else a.loadMem8(dst, offRegisters + v);
+	};
+	// Only the low byte of src is stored, src must be eax, ecx or edx
+	auto storeV = [&](int v, Reg src)
+	{
+		if (hostReg[v] >= 0)
+		{
+			a.movzx8(static_cast<Reg>(hostReg[v]), src);
+			dirty |= 1 << v;
+		}
+		else a.storeMem8(offRegisters + v, src);
+	};
+	auto storeVImm = [&](int v, std::uint8_t value)
+	{
+		if (hostReg[v] >= 0)
+		{
+			a.movImm32(static_cast<Reg>(hostReg[v]), value);
+			dirty |= 1 << v;
+		}
+		else a.storeMem8Imm(offRegisters + v, value);
+	};
+	auto writeBack = [&]()
+	{
+		for (int v : cached)
+		{
+			if (!(dirty & (1 << v))) continue;
+			a.mov32(RCX, static_cast<Reg>(hostReg[v]));
+			a.storeMem8(offRegisters + v, RCX);
+		}
+		dirty = 0;
+		a.storeMem16(offIr, IR);
+	};
+	auto reload = [&]()
+	{
+		for (int v : cached) a.loadMem8(static_cast<Reg>(hostReg[v]), offRegisters + v);
+		a.loadMem16(IR, offIr);
+	};
+
+	// Prologue
+	for (Reg r : SAVED_REGS) a.push(r);
+	a.subRsp(8 + SHADOW_SPACE);
+	a.movImm64(BASE, reinterpret_cast<std::uint64_t>(&chip8));
+	reload();
+
+	enum class Exit { Fallthrough, Constant, Computed, Memory };
+	Exit exit{ Exit::Fallthrough };
+	std::uint16_t exitPc{ pc };
+
+	for (std::size_t i{ 0 }; i < insts.size(); ++i)
+	{
+		const Chip8::Instruction& inst{ insts[i] };
+		const std::uint16_t instPc{ static_cast<std::uint16_t>(address + 2 * i) };
+		const std::uint16_t nextPc{ static_cast<std::uint16_t>(instPc + 2) };
+		const int x{ inst.x };
+		const int y{ inst.y };
+
+		Kind kind{ classify(inst.op) };
+		if (kind == Kind::Helper || kind == Kind::HelperTerminator)
+		{
+			helperSites.push_back({ inst, nextPc });
+
+			writeBack();
+			a.movImm64(ARG0, reinterpret_cast<std::uint64_t>(this));
+			a.movImm64(ARG1, reinterpret_cast<std::uint64_t>(&helperSites.back()));
+			a.movImm64(RAX, reinterpret_cast<std::uint64_t>(&Chip8Jit::callHandler));
+			a.callReg(RAX);
+			reload();
+
+			if (kind == Kind::HelperTerminator) exit = Exit::Memory;
+			continue;
+		}
+
+		// Each sequence below follows its opcode_XXXX handler statement by statement,
+		// so aliasing between X, Y and VF behaves the same as in the interpreter
+		switch (inst.op)
+		{
+		case Chip8::Op::OP_1NNN:
+			exit = Exit::Constant;
+			exitPc = inst.nnn;
+			break;
+		case Chip8::Op::OP_3XNN:
+		case Chip8::Op::OP_4XNN:
+			loadV(RAX, x);
+			a.aluImm32(7, RAX, inst.nn);
+			a.movImm32(RAX, nextPc);
+			a.movImm32(RCX, nextPc + 2);
+			a.cmovcc(inst.op == Chip8::Op::OP_3XNN ? COND_E : COND_NE, RAX, RCX);
+			exit = Exit::Computed;
+			break;
+		case Chip8::Op::OP_5XY0:
+		case Chip8::Op::OP_9XY0:
+			loadV(RAX, x);
+			loadV(RCX, y);
+			a.alu32(0x39, RAX, RCX);
+			a.movImm32(RAX, nextPc);
+			a.movImm32(RCX, nextPc + 2);
+			a.cmovcc(inst.op == Chip8::Op::OP_5XY0 ? COND_E : COND_NE, RAX, RCX);
+			exit = Exit::Computed;
+			break;
+		case Chip8::Op::OP_6XNN:
+			storeVImm(x, inst.nn);
+			break;
+		case Chip8::Op::OP_7XNN:
+			loadV(RAX, x);
+			a.aluImm32(0, RAX, inst.nn);
+			storeV(x, RAX);
+			break;
+		case Chip8::Op::OP_8XY0:
+			loadV(RAX, y);
+			storeV(x, RAX);
+			break;
+		case Chip8::Op::OP_8XY1:
+		case Chip8::Op::OP_8XY2:
+		case Chip8::Op::OP_8XY3:
+			loadV(RAX, x);
+			loadV(RCX, y);
+			a.alu32(inst.op == Chip8::Op::OP_8XY1 ? 0x09 : (inst.op == Chip8::Op::OP_8XY2 ? 0x21 : 0x31), RAX, RCX);
+			storeV(x, RAX);
+			break;
+		case Chip8::Op::OP_8XY4:
+			loadV(RAX, x);
+			loadV(RCX, y);
+			a.alu32(0x01, RAX, RCX);
+			a.mov32(RDX, RAX);
+			a.shiftImm(5, RDX, 8);
+			storeV(0xF, RDX);
+			storeV(x, RAX);
+			break;
+		case Chip8::Op::OP_8XY5:
+		case Chip8::Op::OP_8XY7:
+		{
+			// Both store into X, 8XY7 subtracts it from Y
+			int minuend{ inst.op == Chip8::Op::OP_8XY5 ? x : y };
+			int subtrahend{ inst.op == Chip8::Op::OP_8XY5 ? y : x };
+			loadV(RAX, minuend);
+			loadV(RCX, subtrahend);
+			a.alu32(0x39, RAX, RCX);
+			a.setcc(COND_A, RDX);
+			storeV(0xF, RDX);
+			loadV(RAX, minuend);
+			loadV(RCX, subtrahend);
+			a.alu32(0x29, RAX, RCX);
+			storeV(x, RAX);
+			break;
+		}
+		case Chip8::Op::OP_8XY6:
+		case Chip8::Op::OP_8XYE:
+			if (chip8.profile->shiftUsesY)
+			{
+				loadV(RAX, y);
+				storeV(x, RAX);
+			}
+			loadV(RAX, x);
+			if (inst.op == Chip8::Op::OP_8XY6) a.aluImm32(4, RAX, 0x1);
+			else a.shiftImm(5, RAX, 7);
+			storeV(0xF, RAX);
+			loadV(RAX, x);
+			a.shiftImm(inst.op == Chip8::Op::OP_8XY6 ? 5 : 4, RAX, 1);
+			storeV(x, RAX);
+			break;
+		case Chip8::Op::OP_ANNN:
+			a.movImm32(IR, inst.nnn);
+			break;
+		case Chip8::Op::OP_FX07:
+			a.loadMem8(RAX, offDelay);
+			storeV(x, RAX);
+			break;
+		case Chip8::Op::OP_FX15:
+		case Chip8::Op::OP_FX18:
+			loadV(RAX, x);
+			a.storeMem8(inst.op == Chip8::Op::OP_FX15 ? offDelay : offSound, RAX);
+			break;
+		case Chip8::Op::OP_FX1E:
+			loadV(RAX, x);
+			a.alu32(0x01, RAX, IR);
+			a.aluImm32(7, RAX, 0xFFF);
+			a.setcc(COND_A, RDX);
+			storeV(0xF, RDX);
+			a.movzx16(IR, RAX);
+			break;
+		case Chip8::Op::OP_FX29:
+			loadV(RAX, x);
+			a.imulImm8(RAX, RAX, 5);
+			a.aluImm32(0, RAX, Chip8::FONTCHAR_START);
+			a.movzx16(IR, RAX);
+			break;
+		default:
+			// Unrecognised opcodes are ignored by the interpreter too
+			break;
+		}
+	}
+
+	// Epilogue
+	// writeBack() only uses ecx, so a computed pc stays in eax
+	writeBack();
+	switch (exit)
+	{
+	case Exit::Fallthrough:
+	case Exit::Constant:
+		a.storeMem16Imm(offPc, exitPc);
+		break;
+	case Exit::Computed:
+		a.storeMem16(offPc, RAX);
+		break;
+	case Exit::Memory:
+		break;
+	}
+	a.addRsp(8 + SHADOW_SPACE);
+	for (auto it{ SAVED_REGS.rbegin() }; it != SAVED_REGS.rend(); ++it) a.pop(*it);
+	a.ret();
+
+	if (codeUsed + a.code.size() > CODE_BUFFER_SIZE)
+	{
+		flush();
+		if (a.code.size() > CODE_BUFFER_SIZE) return nullptr;
+		return compile(address);
+	}
+
+	if (!setExecutable(false)) return nullptr;
+	std::uint8_t* code{ codeBuffer + codeUsed };
+	std::memcpy(code, a.code.data(), a.code.size());
+	codeUsed += (a.code.size() + 15) & ~std::size_t{ 15 };
+
+	Block block{};
+	block.code = reinterpret_cast<block_fn>(code);
+	block.start = address;
+	block.end = pc;
+	block.length = static_cast<std::uint32_t>(insts.size());
+	blocks.push_back(block);
+
+	entries[address] = &blocks.back();
+	for (std::size_t i{ block.start }; i < block.end; ++i) codeBytes[i] = true;
+
+	return &blocks.back();
+#else
+	(void)address;
+	return nullptr;
+#endif
+}
+
+bool Chip8Jit::checkLockstep(std::uint16_t blockStart, std::uint32_t instructions)
+{
+	const Chip8& a{ chip8 };
+	const Chip8& b{ *reference };
+
+	std::vector<const char*> differences{};
+	if (a.memory != b.memory) differences.push_back("memory");
+	if (a.registers != b.registers) differences.push_back("registers");
+	if (a.ir != b.ir) differences.push_back("ir");
+	if (a.pc != b.pc) differences.push_back("pc");
+	if (a.stack != b.stack || a.sp != b.sp || a.stackFaulted != b.stackFaulted) differences.push_back("stack");
+	if (a.delayTimer != b.delayTimer) differences.push_back("delay timer");
+	if (a.soundTimer != b.soundTimer) differences.push_back("sound timer");
+	if (a.display != b.display) differences.push_back("display");
+
+	if (differences.empty()) return true;
+
+	diverged = true;
+	std::cout << std::hex << "\nJIT diverged from interpreter in block 0x" << blockStart
+		<< std::dec << " (" << instructions << " instructions):";
+	for (const char* field : differences) std::cout << ' ' << field;
+	std::cout << "\n  jit pc=0x" << std::hex << a.pc << " ir=0x" << a.ir
+		<< ", interpreter pc=0x" << b.pc << " ir=0x" << b.ir << std::dec << '\n';
+	for (int i{ 0 }; i < 16; ++i)
+	{
+		if (a.registers[i] != b.registers[i])
+		{
+			std::cout << "  V" << std::hex << i << ": jit=0x" << static_cast<int>(a.registers[i])
+				<< " interpreter=0x" << static_cast<int>(b.registers[i]) << std::dec << '\n';
+		}
+	}
+	return false;
+}
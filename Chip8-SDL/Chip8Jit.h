@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Chip8.h"
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+// Dynamic recompiler for a Chip8 instance.
+// Basic blocks are translated to x86-64 code on first use; anything else (other hosts,
+// blocks that don't fit the remaining budget, odd addresses) goes through Chip8::cycle().
+// Blocks unlinked because the ROM wrote over them keep their space in the code buffer
+// until it fills up, then everything is flushed and translated again as it runs.
+class Chip8Jit
+{
+public:
+	explicit Chip8Jit(Chip8& chip8);
+	~Chip8Jit();
+
+	Chip8Jit(const Chip8Jit&) = delete;
+	Chip8Jit& operator=(const Chip8Jit&) = delete;
+
+	static bool isSupported();
+
+	// Execute the given number of instructions, returns how many actually ran
+	// (fewer only if lockstep checking found a divergence)
+	std::size_t run(std::size_t instructions);
+
+	// Discard all translated code, must be called after loading a new ROM
+	void flush();
+
+	// Replay everything on an interpreted copy of the machine and compare after each block
+	void setLockstep(bool enabled);
+
+	bool hasDiverged() const
+	{
+		return diverged;
+	}
+
+private:
+	using block_fn = void (*)();
+
+	struct Block
+	{
+		block_fn code{};
+		std::uint16_t start{};		// First byte covered
+		std::uint16_t end{};		// One past the last byte covered
+		std::uint32_t length{};		// Instructions in block
+	};
+
+	// Arguments for a handler called from translated code
+	struct HelperSite
+	{
+		Chip8::Instruction inst{};
+		std::uint16_t nextPc{};
+	};
+
+	static constexpr std::size_t CODE_BUFFER_SIZE{ 4 * 1024 * 1024 };
+	static constexpr std::uint32_t MAX_BLOCK_LENGTH{ 64 };
+
+	Chip8& chip8;
+
+	std::uint8_t* codeBuffer{};
+	std::size_t codeUsed{};
+	bool codeExecutable{ false };	// Buffer is read+execute rather than read+write
+
+	std::deque<Block> blocks{};
+	std::deque<HelperSite> helperSites{};
+	std::array<Block*, Chip8::MEMORY_SIZE> entries{};
+	std::bitset<Chip8::MEMORY_SIZE> codeBytes{};	// Bytes read by any live block
+
+	std::unique_ptr<Chip8> reference{};		// Interpreted copy for lockstep mode
+	bool diverged{ false };
+
+	bool setExecutable(bool executable);
+	Block* compile(std::uint16_t address);
+	void invalidate(std::size_t address, std::size_t length);
+	void stepInterpreter();
+	std::size_t waitForKey(std::size_t instructions);
+	bool checkLockstep(std::uint16_t blockStart, std::uint32_t instructions);
+
+	static void callHandler(Chip8Jit* jit, const HelperSite* site);
+};
@@ -0,0 +1,79 @@
+#include "Disassembler.h"
+
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+	std::string reg(int index)
+	{
+		std::ostringstream name{};
+		name << 'V' << std::uppercase << std::hex << index;
+		return name.str();
+	}
+
+	std::string hex(int value, int digits)
+	{
+		std::ostringstream text{};
+		text << "0x" << std::uppercase << std::hex << std::setw(digits) << std::setfill('0') << value;
+		return text.str();
+	}
+}
+
+std::string Disassembler::disassemble(std::uint16_t opcode, Chip8::Platform platform)
+{
+	const Chip8::Profile& profile{ Chip8::profiles[static_cast<std::size_t>(platform)] };
+	int x{ (opcode & Chip8::BITMASK_X) >> 8 };
+	int y{ (opcode & Chip8::BITMASK_Y) >> 4 };
+	int n{ opcode & Chip8::BITMASK_N };
+	int nn{ opcode & Chip8::BITMASK_NN };
+	int nnn{ opcode & Chip8::BITMASK_NNN };
+
+	using Op = Chip8::Op;
+	switch (Chip8::decodeTable[opcode])
+	{
+	case Op::OP_00E0:	return "CLS";
+	case Op::OP_00EE:	return "RET";
+	case Op::OP_1NNN:	return "JP " + hex(nnn, 3);
+	case Op::OP_2NNN:	return "CALL " + hex(nnn, 3);
+	case Op::OP_3XNN:	return "SE " + reg(x) + ", " + hex(nn, 2);
+	case Op::OP_4XNN:	return "SNE " + reg(x) + ", " + hex(nn, 2);
+	case Op::OP_5XY0:	return "SE " + reg(x) + ", " + reg(y);
+	case Op::OP_6XNN:	return "LD " + reg(x) + ", " + hex(nn, 2);
+	case Op::OP_7XNN:	return "ADD " + reg(x) + ", " + hex(nn, 2);
+	case Op::OP_8XY0:	return "LD " + reg(x) + ", " + reg(y);
+	case Op::OP_8XY1:	return "OR " + reg(x) + ", " + reg(y);
+	case Op::OP_8XY2:	return "AND " + reg(x) + ", " + reg(y);
+	case Op::OP_8XY3:	return "XOR " + reg(x) + ", " + reg(y);
+	case Op::OP_8XY4:	return "ADD " + reg(x) + ", " + reg(y);
+	case Op::OP_8XY5:	return "SUB " + reg(x) + ", " + reg(y);
+	case Op::OP_8XY6:	return "SHR " + reg(x) + (profile.shiftUsesY ? ", " + reg(y) : "");
+	case Op::OP_8XY7:	return "SUBN " + reg(x) + ", " + reg(y);
+	case Op::OP_8XYE:	return "SHL " + reg(x) + (profile.shiftUsesY ? ", " + reg(y) : "");
+	case Op::OP_9XY0:	return "SNE " + reg(x) + ", " + reg(y);
+	case Op::OP_ANNN:	return "LD I, " + hex(nnn, 3);
+	case Op::OP_BNNN:	return "JP " + (profile.jumpOffsetUsesX ? reg(x) : reg(0)) + ", " + hex(nnn, 3);
+	case Op::OP_CXNN:	return "RND " + reg(x) + ", " + hex(nn, 2);
+	case Op::OP_DXYN:	return "DRW " + reg(x) + ", " + reg(y) + ", " + std::to_string(n);
+	case Op::OP_EX9E:	return "SKP " + reg(x);
+	case Op::OP_EXA1:	return "SKNP " + reg(x);
+	case Op::OP_FX07:	return "LD " + reg(x) + ", DT";
+	case Op::OP_FX0A:	return "LD " + reg(x) + ", K";
+	case Op::OP_FX15:	return "LD DT, " + reg(x);
+	case Op::OP_FX18:	return "LD ST, " + reg(x);
+	case Op::OP_FX1E:	return "ADD I, " + reg(x);
+	case Op::OP_FX29:	return "LD F, " + reg(x);
+	case Op::OP_FX33:	return "LD B, " + reg(x);
+	case Op::OP_FX55:	return "LD [I], " + reg(x);
+	case Op::OP_FX65:	return "LD " + reg(x) + ", [I]";
+	case Op::NOP:
+	case Op::COUNT:
+		break;
+	}
+	return "DW " + hex(opcode, 4);
+}
+
+bool Disassembler::isInstruction(std::uint16_t opcode)
+{
+	return Chip8::decodeTable[opcode] != Chip8::Op::NOP;
+}
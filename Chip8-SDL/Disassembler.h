@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Chip8.h"
+
+#include <cstdint>
+#include <string>
+
+// Chip-8 mnemonics in the style of Cowgod's technical reference, e.g. "LD VA, 0x05" or "DRW V0, V1, 5".
+// Opcodes are decoded through the core's own decode table, so what is shown is what Chip8 executes.
+class Disassembler
+{
+public:
+	// BNNN and the shifts read differently depending on the platform's quirks.
+	// Opcodes the core ignores come out as "DW 0x0123".
+	static std::string disassemble(std::uint16_t opcode, Chip8::Platform platform);
+
+	// False for opcodes the core ignores
+	static bool isInstruction(std::uint16_t opcode);
+};
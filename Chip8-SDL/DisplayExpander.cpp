@@ -0,0 +1,179 @@
+#include "DisplayExpander.h"
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DISPLAY_EXPANDER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit vector instructions for the targets a function asks for, MSVC always can
+#if defined(__GNUC__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+namespace
+{
+	void expandScalar(const Chip8::framebuffer_type& framebuffer, Chip8::display_type& rgba, int firstRow, int endRow)
+	{
+		for (int y{ firstRow }; y < endRow; ++y)
+		{
+			std::uint64_t displayRow{ framebuffer[y] };
+			for (int x{ 0 }; x < Chip8::DISPLAY_WIDTH; ++x)
+			{
+				rgba[(y * Chip8::DISPLAY_WIDTH) + x] = ((displayRow >> (63 - x)) & 1) ? 0xFFFFFFFF : 0;
+			}
+		}
+	}
+
+#if defined(DISPLAY_EXPANDER_X86)
+	TARGET_SSE2 void expandSse2(const Chip8::framebuffer_type& framebuffer, Chip8::display_type& rgba, int firstRow, int endRow)
+	{
+		// Bit of the sprite byte tested by each lane, the leftmost pixel is the high bit
+		const __m128i leftBits = _mm_set_epi32(0x10, 0x20, 0x40, 0x80);
+		const __m128i rightBits = _mm_set_epi32(0x01, 0x02, 0x04, 0x08);
+
+		std::uint32_t* pixel{ rgba.data() + (firstRow * Chip8::DISPLAY_WIDTH) };
+		for (int y{ firstRow }; y < endRow; ++y)
+		{
+			std::uint64_t displayRow{ framebuffer[y] };
+			for (int shift{ 56 }; shift >= 0; shift -= 8)
+			{
+				const __m128i spriteByte = _mm_set1_epi32(static_cast<int>((displayRow >> shift) & 0xFF));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pixel), _mm_cmpeq_epi32(_mm_and_si128(spriteByte, leftBits), leftBits));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pixel + 4), _mm_cmpeq_epi32(_mm_and_si128(spriteByte, rightBits), rightBits));
+				pixel += 8;
+			}
+		}
+	}
+
+	TARGET_AVX2 void expandAvx2(const Chip8::framebuffer_type& framebuffer, Chip8::display_type& rgba, int firstRow, int endRow)
+	{
+		const __m256i bits = _mm256_set_epi32(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80);
+
+		std::uint32_t* pixel{ rgba.data() + (firstRow * Chip8::DISPLAY_WIDTH) };
+		for (int y{ firstRow }; y < endRow; ++y)
+		{
+			std::uint64_t displayRow{ framebuffer[y] };
+			for (int shift{ 56 }; shift >= 0; shift -= 8)
+			{
+				const __m256i spriteByte = _mm256_set1_epi32(static_cast<int>((displayRow >> shift) & 0xFF));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(pixel), _mm256_cmpeq_epi32(_mm256_and_si256(spriteByte, bits), bits));
+				pixel += 8;
+			}
+		}
+	}
+#endif
+
+	bool cpuHasSse2()
+	{
+#if defined(__x86_64__) || defined(_M_X64)
+		return true;	// Part of the x86-64 baseline
+#elif defined(DISPLAY_EXPANDER_X86) && defined(__GNUC__)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse2");
+#elif defined(DISPLAY_EXPANDER_X86) && defined(_MSC_VER)
+		int info[4]{};
+		__cpuid(info, 1);
+		return (info[3] & (1 << 26)) != 0;
+#else
+		return false;
+#endif
+	}
+
+	bool cpuHasAvx2()
+	{
+#if defined(DISPLAY_EXPANDER_X86) && defined(__GNUC__)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#elif defined(DISPLAY_EXPANDER_X86) && defined(_MSC_VER)
+		int info[4]{};
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+
+		// AVX needs OSXSAVE and the OS saving YMM state, not just the CPUID bit
+		__cpuid(info, 1);
+		bool osSavesYmm{ (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 0x6) == 0x6) };
+		if (!osSavesYmm) return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return false;
+#endif
+	}
+}
+
+bool DisplayExpander::isSupported(Kernel kernel)
+{
+	static const bool hasSse2{ cpuHasSse2() };
+	static const bool hasAvx2{ cpuHasAvx2() };
+
+	switch (kernel)
+	{
+	case Kernel::Sse2:
+		return hasSse2;
+	case Kernel::Avx2:
+		return hasAvx2;
+	default:
+		return true;
+	}
+}
+
+DisplayExpander::Kernel DisplayExpander::best()
+{
+	static const Kernel kernel
+	{
+		isSupported(Kernel::Avx2) ? Kernel::Avx2 :
+		isSupported(Kernel::Sse2) ? Kernel::Sse2 :
+		Kernel::Scalar
+	};
+	return kernel;
+}
+
+void DisplayExpander::expand(const Chip8::framebuffer_type& framebuffer, Chip8::display_type& rgba)
+{
+	expandRows(framebuffer, rgba, 0, Chip8::DISPLAY_HEIGHT, best());
+}
+
+void DisplayExpander::expand(const Chip8::framebuffer_type& framebuffer, Chip8::display_type& rgba, Kernel kernel)
+{
+	expandRows(framebuffer, rgba, 0, Chip8::DISPLAY_HEIGHT, kernel);
+}
+
+void DisplayExpander::expandRows(const Chip8::framebuffer_type& framebuffer, Chip8::display_type& rgba, int firstRow, int rowCount)
+{
+	expandRows(framebuffer, rgba, firstRow, rowCount, best());
+}
+
+// Unsupported kernels fall back to the scalar loop
+void DisplayExpander::expandRows(const Chip8::framebuffer_type& framebuffer, Chip8::display_type& rgba, int firstRow, int rowCount, Kernel kernel)
+{
+	static_assert(Chip8::DISPLAY_WIDTH % 8 == 0, "Rows are expanded one sprite byte at a time");
+
+	int endRow{ firstRow + rowCount };
+
+#if defined(DISPLAY_EXPANDER_X86)
+	if (kernel == Kernel::Avx2 && isSupported(Kernel::Avx2))
+	{
+		expandAvx2(framebuffer, rgba, firstRow, endRow);
+		return;
+	}
+	if (kernel == Kernel::Sse2 && isSupported(Kernel::Sse2))
+	{
+		expandSse2(framebuffer, rgba, firstRow, endRow);
+		return;
+	}
+#else
+	(void)kernel;
+#endif
+
+	expandScalar(framebuffer, rgba, firstRow, endRow);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Chip8.h"
+
+// Converts the packed framebuffer to RGBA pixels for rendering.
+// Each sprite-sized byte of a row becomes eight 32-bit pixels with one vector compare where the CPU allows it.
+class DisplayExpander
+{
+public:
+	enum class Kernel
+	{
+		Scalar,	// One pixel at a time
+		Sse2,	// Four pixels per 128-bit compare
+		Avx2	// Eight pixels per 256-bit compare
+	};
+
+	// Widest kernel the host CPU supports, detected once
+	static Kernel best();
+	static bool isSupported(Kernel kernel);
+
+	// Lit pixels become 0xFFFFFFFF, the same values Chip8::getDisplay() produces
+	static void expand(const Chip8::framebuffer_type& framebuffer, Chip8::display_type& rgba);
+	static void expand(const Chip8::framebuffer_type& framebuffer, Chip8::display_type& rgba, Kernel kernel);
+
+	// Only rewrite rows [firstRow, firstRow + rowCount), the rest of rgba is left as it was
+	static void expandRows(const Chip8::framebuffer_type& framebuffer, Chip8::display_type& rgba, int firstRow, int rowCount);
+	static void expandRows(const Chip8::framebuffer_type& framebuffer, Chip8::display_type& rgba, int firstRow, int rowCount, Kernel kernel);
+};
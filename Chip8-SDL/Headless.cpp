@@ -0,0 +1,101 @@
+#include "Headless.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+bool Headless::loadRom(const std::string& filename, std::vector<std::uint8_t>& rom)
+{
+	std::ifstream romFile{ filename, std::ios::binary };
+	if (!romFile)
+	{
+		std::cout << "File not found: " << filename << std::endl;
+		return false;
+	}
+
+	rom.assign(std::istreambuf_iterator<char>(romFile), std::istreambuf_iterator<char>());
+	if (rom.size() > Chip8::MAX_ROM_SIZE)
+	{
+		std::cout << "ROM too large: " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Each line is "<frame> <keys>", keys being the hex digits of every key held from that frame on, or "-" for none
+bool Headless::loadInputScript(const std::string& filename, input_script_type& script)
+{
+	std::ifstream scriptFile{ filename };
+	if (!scriptFile)
+	{
+		std::cout << "File not found: " << filename << std::endl;
+		return false;
+	}
+
+	script.clear();
+	std::string line{};
+	int lineNumber{ 0 };
+	while (std::getline(scriptFile, line))
+	{
+		++lineNumber;
+		if (line.empty() || line[0] == '#') continue;
+
+		InputEvent event{};
+		std::string keys{};
+		std::istringstream fields{ line };
+		if (!(fields >> event.frame >> keys))
+		{
+			std::cout << filename << ':' << lineNumber << ": expected <frame> <keys>" << std::endl;
+			return false;
+		}
+
+		if (keys != "-")
+		{
+			for (char key : keys)
+			{
+				if (!std::isxdigit(static_cast<unsigned char>(key)))
+				{
+					std::cout << filename << ':' << lineNumber << ": '" << key << "' is not a key" << std::endl;
+					return false;
+				}
+				event.keys |= static_cast<std::uint16_t>(1 << std::stoi(std::string{ key }, nullptr, 16));
+			}
+		}
+
+		script.push_back(event);
+	}
+
+	std::stable_sort(script.begin(), script.end(), [](const InputEvent& a, const InputEvent& b) { return a.frame < b.frame; });
+	return true;
+}
+
+void Headless::pressKeys(const input_script_type* script, std::size_t& nextEvent, std::uint32_t frame, Chip8& chip8)
+{
+	Chip8::keypad_type& keypad{ chip8.getKeypad() };
+	while (script && nextEvent < script->size() && (*script)[nextEvent].frame <= frame)
+	{
+		for (int key{ 0 }; key < Chip8::KEY_COUNT; ++key)
+		{
+			keypad[key] = ((*script)[nextEvent].keys >> key) & 1;
+		}
+		++nextEvent;
+	}
+}
+
+// Over the rows, most significant byte first, so the hash doesn't depend on the host's byte order
+std::uint64_t Headless::hashFramebuffer(const Chip8::framebuffer_type& framebuffer)
+{
+	std::uint64_t hash{ 0xCBF29CE484222325 };
+	for (std::uint64_t row : framebuffer)
+	{
+		for (int shift{ 56 }; shift >= 0; shift -= 8)
+		{
+			hash ^= (row >> shift) & 0xFF;
+			hash *= 0x100000001B3;
+		}
+	}
+	return hash;
+}
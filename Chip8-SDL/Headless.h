@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Chip8.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What the headless tools share: ROM files, input scripts and the framebuffer hash. Chip8-Batch's results and
+// Chip8-Regression's golden file both depend on these, so there is only one definition of each.
+class Headless
+{
+public:
+	// Keys held from a frame onwards, bit n is key n
+	struct InputEvent
+	{
+		std::uint32_t frame{};
+		std::uint16_t keys{};
+	};
+
+	using input_script_type = std::vector<InputEvent>;
+
+	// Fails if the file is missing or larger than Chip8::MAX_ROM_SIZE
+	static bool loadRom(const std::string& filename, std::vector<std::uint8_t>& rom);
+
+	// The events come back in frame order, see Chip8-Batch/README.md for the format
+	static bool loadInputScript(const std::string& filename, input_script_type& script);
+
+	// Applies every event of script up to frame, starting from nextEvent. A null script holds no keys.
+	static void pressKeys(const input_script_type* script, std::size_t& nextEvent, std::uint32_t frame, Chip8& chip8);
+
+	// 64-bit FNV-1a, the same on every host
+	static std::uint64_t hashFramebuffer(const Chip8::framebuffer_type& framebuffer);
+};
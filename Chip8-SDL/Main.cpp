@@ -1,11 +1,21 @@
 #include "Chip8.h"
+#include "Movie.h"
+#include "Profiler.h"
 #include "Renderer.h"
+#include "RewindBuffer.h"
 
 #include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <stdexcept>
+#include <string>
 
-void getRom(Chip8& chip8)
+std::string getRom(Chip8& chip8)
 {
 	std::string fileName{};
 	do
@@ -13,45 +23,179 @@ void getRom(Chip8& chip8)
 		std::cout << "\nEnter rom file name: ";
 		std::cin >> fileName;
 	} while (!chip8.loadRom(fileName));
+	return fileName;
+}
+
+// A frame number for --play, false if text isn't one
+bool parseFrame(const std::string& text, std::uint32_t& frame)
+{
+	if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) return false;
+	try
+	{
+		std::size_t length{ 0 };
+		unsigned long value{ std::stoul(text, &length) };
+		if (length != text.size() || value > std::numeric_limits<std::uint32_t>::max()) return false;
+		frame = static_cast<std::uint32_t>(value);
+		return true;
+	}
+	catch (const std::out_of_range&)
+	{
+		return false;
+	}
 }
 
 int main(int argc, char* argv[])
 {
-	const static double INSTRUCTIONS_PER_SEC = 0.3;
+	const static std::uint32_t INSTRUCTIONS_PER_FRAME = 5;	// 300 instructions per second
+	const static double FRAME_TIME_MS = 1000.0 / Chip8::DELAY_TIMER_HZ;
 
 	Renderer renderer{ "Chip8mu", Chip8::DISPLAY_WIDTH, Chip8::DISPLAY_HEIGHT, 10 };
 
 	auto chip8{ std::make_unique<Chip8>() };
+	std::string romFile{};
 	if (argc > 1)
 	{
-		if (!chip8->loadRom(argv[1])) return 1;
+		romFile = argv[1];
+		if (!chip8->loadRom(romFile)) return 1;
 	}
 	else
 	{
-		getRom(*chip8);
+		romFile = getRom(*chip8);
 	}
-	
 
-	int videoWidth{ sizeof(chip8->getDisplay()[0]) * Chip8::DISPLAY_WIDTH };
+	// F5 saves and F9 loads a single state kept next to the ROM
+	const std::string stateFile{ romFile + ".state" };
+	Renderer::Hotkeys hotkeys{};
+
+	chip8->setInstructionsPerFrame(INSTRUCTIONS_PER_FRAME);
+
+	// Chip8 <rom> --record <movie> logs the session's input, --play <movie> [frame] replays it
+	Movie movie{};
+	std::string movieFile{};
+	bool recording{ false };
+	bool playing{ false };
+	if (argc > 2)
+	{
+		const std::string mode{ argv[2] };
+		if (mode != "--record" && mode != "--play")
+		{
+			std::cout << "Unknown option " << mode << ".\n";
+			return 1;
+		}
+		if (argc < 4)
+		{
+			std::cout << "Usage: Chip8 <rom> [--record <movie> | --play <movie> [frame]]\n";
+			return 1;
+		}
+
+		movieFile = argv[3];
+		if (mode == "--record")
+		{
+			movie.startRecording(*chip8, static_cast<std::uint32_t>(std::time(nullptr)));
+			recording = true;
+		}
+		else
+		{
+			if (!movie.load(movieFile)) return 1;
+			std::uint32_t startFrame{ 0 };
+			if (argc > 4 && !parseFrame(argv[4], startFrame))
+			{
+				std::cout << argv[4] << " is not a frame number.\n";
+				return 1;
+			}
+			if (!movie.seek(*chip8, startFrame)) return 1;
+			playing = true;
+		}
+	}
+
+	// Keys pressed during playback land here instead of in the movie's input
+	Chip8::keypad_type liveKeys{};
+
+	// Every frame is recorded, holding Backspace plays them back in reverse
+	auto rewind{ std::make_unique<RewindBuffer>() };
+	rewind->push(*chip8);
 
 	auto t_start = std::chrono::high_resolution_clock::now();
 
 	bool quit = false;
 	while (!quit)
 	{
-		quit = renderer.processInput(chip8->getKeypad());
+		quit = renderer.processInput(playing ? liveKeys : chip8->getKeypad(), hotkeys);
+
+		// Loading a state or rewinding would leave the movie behind
+		if (recording || playing)
+		{
+			hotkeys.loadState = false;
+			hotkeys.rewind = false;
+		}
+
+		if (hotkeys.saveState && chip8->saveState(stateFile)) std::cout << "\nSaved state to " << stateFile << '\n';
+		if (hotkeys.loadState)
+		{
+			// Keep the keys that are physically held, not the ones held when the state was saved
+			Chip8::keypad_type held{ chip8->getKeypad() };
+			if (chip8->loadState(stateFile))
+			{
+				chip8->getKeypad() = held;
+				std::cout << "\nLoaded state from " << stateFile << '\n';
+			}
+		}
 
 		auto t_end = std::chrono::high_resolution_clock::now();
 		double elapsed_time_ms = std::chrono::duration<double, std::milli>(t_end - t_start).count();
 
-		if (elapsed_time_ms > (1 / INSTRUCTIONS_PER_SEC))
+		if (elapsed_time_ms > FRAME_TIME_MS)
 		{
+			// One call per 60Hz frame, the timers tick once at its end
 			t_start = t_end;
-			chip8->cycle();
-			renderer.update(chip8->getDisplay(), videoWidth);
+			if (hotkeys.rewind)
+			{
+				Chip8::keypad_type held{ chip8->getKeypad() };
+				rewind->stepBack(*chip8);
+				chip8->getKeypad() = held;
+				renderer.update(chip8->getFramebuffer(), chip8->getDirtyRows());
+				chip8->clearDirtyRows();
+				continue;
+			}
+
+			if (recording) movie.recordFrame(*chip8);
+			if (playing && !movie.playFrame(*chip8))
+			{
+				std::cout << "\nMovie ended at frame " << movie.getFrame() << '\n';
+				chip8->getKeypad() = liveKeys;
+				playing = false;
+			}
+
+			Chip8::FrameResult frame{ chip8->runFrame() };
+			rewind->push(*chip8);
+			renderer.update(chip8->getFramebuffer(), chip8->getDirtyRows());
+			chip8->clearDirtyRows();
+
+			// Waiting on FX0A with both timers stopped, nothing can change until a key is pressed
+			// A playing movie supplies the key itself
+			if (frame.waitingForKey && !frame.timersRunning && !playing)
+			{
+				renderer.waitForInput();
+				t_start = std::chrono::high_resolution_clock::now();
+			}
+		}
+		else
+		{
+			// Sleep until the next frame is due, input wakes the loop early so keys are still read straight away
+			renderer.waitForInput(static_cast<int>(std::ceil(FRAME_TIME_MS - elapsed_time_ms)));
 		}
 
 	}
 
+	if (recording && movie.save(movieFile))
+	{
+		std::cout << "\nRecorded " << movie.frames() << " frames to " << movieFile << '\n';
+	}
+
+#if defined(CHIP8_PROFILE)
+	// Profiling builds leave what the session executed next to the ROM
+	if (Profiler::write(*chip8, romFile + ".profile")) std::cout << "\nWrote the profile to " << romFile << ".profile.*\n";
+#endif
+
 	return 0;
 }
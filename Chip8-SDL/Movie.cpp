@@ -0,0 +1,277 @@
+#include "Movie.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <utility>
+
+namespace
+{
+	constexpr char MOVIE_MAGIC[4]{ 'C', '8', 'M', 'V' };
+	constexpr std::uint32_t MOVIE_VERSION{ 1 };
+
+	// Multi-byte values are written little-endian a byte at a time, so movies move between hosts
+	template<typename T>
+	void put(std::vector<std::uint8_t>& out, T value)
+	{
+		for (std::size_t i{ 0 }; i < sizeof(T); ++i)
+		{
+			out.push_back(static_cast<std::uint8_t>(static_cast<std::uint64_t>(value) >> (8 * i)));
+		}
+	}
+
+	// Reads from a loaded movie, failing instead of reading past its end
+	class Reader
+	{
+	public:
+		explicit Reader(const std::vector<std::uint8_t>& bytes)
+			: data{ bytes }
+		{
+		}
+
+		template<typename T>
+		bool get(T& value)
+		{
+			if (data.size() - offset < sizeof(T)) return false;
+
+			std::uint64_t bits{ 0 };
+			for (std::size_t i{ 0 }; i < sizeof(T); ++i)
+			{
+				bits |= static_cast<std::uint64_t>(data[offset++]) << (8 * i);
+			}
+			value = static_cast<T>(bits);
+			return true;
+		}
+
+		bool get(std::vector<std::uint8_t>& bytes, std::size_t length)
+		{
+			if (data.size() - offset < length) return false;
+
+			bytes.assign(data.begin() + static_cast<std::ptrdiff_t>(offset), data.begin() + static_cast<std::ptrdiff_t>(offset + length));
+			offset += length;
+			return true;
+		}
+
+		bool atEnd() const
+		{
+			return offset == data.size();
+		}
+
+	private:
+		const std::vector<std::uint8_t>& data;
+		std::size_t offset{ 0 };
+	};
+}
+
+void Movie::startRecording(Chip8& chip8, std::uint32_t rngSeed, std::uint32_t rngStream)
+{
+	chip8.seedRng(rngSeed, rngStream);
+
+	seed = rngSeed;
+	stream = rngStream;
+	platform = chip8.getPlatform();
+	instructionsPerFrame = chip8.getInstructionsPerFrame();
+	displayWait = chip8.getDisplayWait();
+
+	events.clear();
+	keyframes.clear();
+	frameCount = 0;
+	frame = 0;
+	nextEvent = 0;
+	desynced = false;
+
+	// The first frame always logs the keypad, so playback never depends on what was held before it
+	lastKeys = static_cast<std::uint16_t>(~keysOf(chip8));
+}
+
+void Movie::recordFrame(const Chip8& chip8)
+{
+	if (frame % KEYFRAME_INTERVAL == 0)
+	{
+		keyframes.push_back(Keyframe{ frame, chip8.saveState() });
+	}
+
+	std::uint16_t keys{ keysOf(chip8) };
+	if (keys != lastKeys)
+	{
+		events.push_back(InputEvent{ frame, chip8.getInstructionCount(), keys });
+		lastKeys = keys;
+	}
+
+	frameCount = ++frame;
+}
+
+bool Movie::startPlayback(Chip8& chip8)
+{
+	desynced = false;
+	return seek(chip8, 0);
+}
+
+bool Movie::playFrame(Chip8& chip8)
+{
+	if (frame >= frameCount) return false;
+
+	Chip8::keypad_type& keypad{ chip8.getKeypad() };
+	for (; nextEvent < events.size() && events[nextEvent].frame == frame; ++nextEvent)
+	{
+		const InputEvent& event{ events[nextEvent] };
+		if (event.instruction != chip8.getInstructionCount() && !desynced)
+		{
+			desynced = true;
+			std::cout << "Movie desynced at frame " << frame << ": input recorded at instruction " << event.instruction
+				<< ", replayed at " << chip8.getInstructionCount() << '\n';
+		}
+
+		for (int key{ 0 }; key < Chip8::KEY_COUNT; ++key)
+		{
+			keypad[key] = static_cast<std::uint8_t>((event.keys >> key) & 1);
+		}
+	}
+
+	++frame;
+	return true;
+}
+
+bool Movie::seek(Chip8& chip8, std::uint32_t target)
+{
+	if (keyframes.empty() || target > frameCount)
+	{
+		std::cout << "Frame " << target << " is not in the movie.\n";
+		return false;
+	}
+
+	// Latest keyframe at or before target, keyframes are in frame order
+	auto keyframe{ std::upper_bound(keyframes.begin(), keyframes.end(), target,
+		[](std::uint32_t value, const Keyframe& key) { return value < key.frame; }) - 1 };
+	if (!chip8.loadState(keyframe->state)) return false;
+
+	frame = keyframe->frame;
+	nextEvent = static_cast<std::size_t>(std::lower_bound(events.begin(), events.end(), frame,
+		[](const InputEvent& event, std::uint32_t value) { return event.frame < value; }) - events.begin());
+
+	while (frame < target)
+	{
+		playFrame(chip8);
+		chip8.runFrame();
+	}
+	return true;
+}
+
+bool Movie::save(const std::string& filename) const
+{
+	std::vector<std::uint8_t> out{};
+	out.insert(out.end(), std::begin(MOVIE_MAGIC), std::end(MOVIE_MAGIC));
+	put(out, MOVIE_VERSION);
+	put(out, seed);
+	put(out, stream);
+	put(out, static_cast<std::uint8_t>(platform));
+	put(out, static_cast<std::uint8_t>(displayWait));
+	put(out, instructionsPerFrame);
+	put(out, frameCount);
+	put(out, static_cast<std::uint32_t>(events.size()));
+	put(out, static_cast<std::uint32_t>(keyframes.size()));
+
+	for (const InputEvent& event : events)
+	{
+		put(out, event.frame);
+		put(out, event.instruction);
+		put(out, event.keys);
+	}
+
+	for (const Keyframe& keyframe : keyframes)
+	{
+		put(out, keyframe.frame);
+		put(out, static_cast<std::uint32_t>(keyframe.state.size()));
+		out.insert(out.end(), keyframe.state.begin(), keyframe.state.end());
+	}
+
+	std::ofstream movieFile{ filename, std::ios::binary };
+	if (!movieFile.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size())))
+	{
+		std::cout << "Failed to write " << filename << '\n';
+		return false;
+	}
+	return true;
+}
+
+bool Movie::load(const std::string& filename)
+{
+	std::ifstream movieFile{ filename, std::ios::binary };
+	if (!movieFile)
+	{
+		std::cout << "File not found.\n";
+		return false;
+	}
+
+	std::vector<std::uint8_t> data(std::istreambuf_iterator<char>(movieFile), {});
+	if (data.size() < sizeof(MOVIE_MAGIC) || std::memcmp(data.data(), MOVIE_MAGIC, sizeof(MOVIE_MAGIC)) != 0)
+	{
+		std::cout << "Not a movie.\n";
+		return false;
+	}
+
+	Reader reader{ data };
+	std::vector<std::uint8_t> magic{};
+	std::uint32_t version{};
+	reader.get(magic, sizeof(MOVIE_MAGIC));
+	if (!reader.get(version) || version != MOVIE_VERSION)
+	{
+		std::cout << "Unsupported movie version " << version << ".\n";
+		return false;
+	}
+
+	std::uint8_t platformId{};
+	std::uint8_t displayWaitFlag{};
+	std::uint32_t eventCount{};
+	std::uint32_t keyframeCount{};
+	bool valid{ reader.get(seed) && reader.get(stream) && reader.get(platformId) && reader.get(displayWaitFlag) &&
+		reader.get(instructionsPerFrame) && reader.get(frameCount) && reader.get(eventCount) && reader.get(keyframeCount) };
+
+	events.clear();
+	for (std::uint32_t i{ 0 }; valid && i < eventCount; ++i)
+	{
+		InputEvent event{};
+		valid = reader.get(event.frame) && reader.get(event.instruction) && reader.get(event.keys);
+		events.push_back(event);
+	}
+
+	keyframes.clear();
+	for (std::uint32_t i{ 0 }; valid && i < keyframeCount; ++i)
+	{
+		Keyframe keyframe{};
+		std::uint32_t length{};
+		valid = reader.get(keyframe.frame) && reader.get(length) && reader.get(keyframe.state, length);
+		keyframes.push_back(std::move(keyframe));
+	}
+
+	auto byFrame = [](const auto& a, const auto& b) { return a.frame < b.frame; };
+	if (!valid || !reader.atEnd() || keyframes.empty() || keyframes.front().frame != 0 ||
+		platformId > static_cast<std::uint8_t>(Chip8::Platform::XoChip) ||
+		!std::is_sorted(events.begin(), events.end(), byFrame) || !std::is_sorted(keyframes.begin(), keyframes.end(), byFrame))
+	{
+		std::cout << "Movie is corrupt.\n";
+		events.clear();
+		keyframes.clear();
+		frameCount = 0;
+		return false;
+	}
+
+	platform = static_cast<Chip8::Platform>(platformId);
+	displayWait = displayWaitFlag != 0;
+	frame = 0;
+	nextEvent = 0;
+	desynced = false;
+	return true;
+}
+
+std::uint16_t Movie::keysOf(const Chip8& chip8)
+{
+	std::uint16_t keys{ 0 };
+	for (int key{ 0 }; key < Chip8::KEY_COUNT; ++key)
+	{
+		if (chip8.getKeypad()[key]) keys |= static_cast<std::uint16_t>(1 << key);
+	}
+	return keys;
+}
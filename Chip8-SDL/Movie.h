@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Chip8.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Input recording and replay.
+// A movie starts from a save state of a freshly seeded machine and logs every keypad change, keyed by frame and by
+// the instruction count it happened at, so replaying it reproduces the run exactly and can tell when it doesn't.
+// A save state is also kept every KEYFRAME_INTERVAL frames, so seeking only re-runs the frames since the last one.
+//
+// Drive it with one call per frame, before Chip8::runFrame(): recordFrame() while recording, playFrame() while
+// replaying. Loading states or rewinding in between breaks the movie.
+class Movie
+{
+public:
+	static constexpr std::uint32_t KEYFRAME_INTERVAL{ 3600 };	// One minute at 60Hz
+
+	// The keypad from frame on, bit n is key n
+	struct InputEvent
+	{
+		std::uint32_t frame{};
+		std::uint64_t instruction{};	// Chip8::getInstructionCount() when the change was applied
+		std::uint16_t keys{};
+	};
+
+	// Seeds chip8 and starts a new movie from its current state, which becomes frame 0
+	void startRecording(Chip8& chip8, std::uint32_t rngSeed, std::uint32_t rngStream = 0);
+	void recordFrame(const Chip8& chip8);
+
+	// Restores the movie's first frame into chip8
+	bool startPlayback(Chip8& chip8);
+
+	// Applies this frame's input, false once every recorded frame has been played
+	bool playFrame(Chip8& chip8);
+
+	// Leaves chip8 where playback would be just before target, running at most KEYFRAME_INTERVAL frames to get there
+	bool seek(Chip8& chip8, std::uint32_t target);
+
+	bool save(const std::string& filename) const;
+	bool load(const std::string& filename);
+
+	// Frames recorded, or in the loaded movie
+	std::uint32_t frames() const
+	{
+		return frameCount;
+	}
+
+	// Next frame to be recorded or played
+	std::uint32_t getFrame() const
+	{
+		return frame;
+	}
+
+	// Playback reached an input at a different instruction count than when it was recorded
+	bool isDesynced() const
+	{
+		return desynced;
+	}
+
+private:
+	struct Keyframe
+	{
+		std::uint32_t frame{};
+		std::vector<std::uint8_t> state{};	// Chip8::saveState()
+	};
+
+	// Recorded with the movie so its configuration can be checked without restoring a state
+	std::uint32_t seed{};
+	std::uint32_t stream{};
+	Chip8::Platform platform{};
+	std::uint32_t instructionsPerFrame{};
+	bool displayWait{};
+
+	std::vector<InputEvent> events{};
+	std::vector<Keyframe> keyframes{};
+	std::uint32_t frameCount{};
+
+	std::uint32_t frame{};
+	std::size_t nextEvent{};
+	std::uint16_t lastKeys{};
+	bool desynced{ false };
+
+	static std::uint16_t keysOf(const Chip8& chip8);
+};
@@ -0,0 +1,169 @@
+#include "Profiler.h"
+
+#if defined(CHIP8_PROFILE)
+
+#include "Disassembler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <sstream>
+
+namespace
+{
+	// Must stay in the same order as Chip8::Op
+	constexpr const char* HANDLER_NAMES[]
+	{
+		"opcode_NOP",
+		"opcode_00E0", "opcode_00EE", "opcode_1NNN", "opcode_2NNN", "opcode_3XNN", "opcode_4XNN", "opcode_5XY0",
+		"opcode_6XNN", "opcode_7XNN", "opcode_8XY0", "opcode_8XY1", "opcode_8XY2", "opcode_8XY3", "opcode_8XY4",
+		"opcode_8XY5", "opcode_8XY6", "opcode_8XY7", "opcode_8XYE", "opcode_9XY0", "opcode_ANNN", "opcode_BNNN",
+		"opcode_CXNN", "opcode_DXYN", "opcode_EX9E", "opcode_EXA1", "opcode_FX07", "opcode_FX0A", "opcode_FX15",
+		"opcode_FX18", "opcode_FX1E", "opcode_FX29", "opcode_FX33", "opcode_FX55", "opcode_FX65"
+	};
+
+	std::string hex(unsigned value, int digits)
+	{
+		std::ostringstream text{};
+		text << "0x" << std::uppercase << std::hex << std::setw(digits) << std::setfill('0') << value;
+		return text.str();
+	}
+
+	// The opcode at an address as memory holds it now, which self-modifying code may have changed since it ran
+	std::uint16_t opcodeAt(const Chip8& chip8, std::size_t address)
+	{
+		const Chip8::memory_type& memory{ chip8.getMemory() };
+		return static_cast<std::uint16_t>((memory[address] << 8) | memory[address + 1]);
+	}
+}
+
+void Profiler::writeJson(const Chip8& chip8, std::ostream& out)
+{
+	const Chip8::ExecutionProfile& counts{ chip8.executionProfile };
+	std::uint64_t fetched{ std::accumulate(counts.handlers.begin(), counts.handlers.end(), std::uint64_t{ 0 }) };
+
+	out << "{\n"
+		<< "  \"instructions\": " << chip8.getInstructionCount() << ",\n"
+		<< "  \"fetched\": " << fetched << ",\n"
+		<< "  \"fast_forwarded\": " << counts.fastForwarded << ",\n"
+		<< "  \"fx0a_wait_instructions\": " << counts.keyWaitInstructions << ",\n"
+		<< "  \"dxyn\": { \"executions\": " << counts.handlers[static_cast<std::size_t>(Chip8::Op::OP_DXYN)]
+		<< ", \"pixels_drawn\": " << counts.pixelsDrawn << ", \"pixels_erased\": " << counts.pixelsErased
+		<< ", \"collisions\": " << counts.collisions << " },\n";
+
+	out << "  \"handlers\": {";
+	for (std::size_t handler{ 0 }; handler < counts.handlers.size(); ++handler)
+	{
+		out << (handler == 0 ? "\n" : ",\n") << "    \"" << handlerName(handler) << "\": " << counts.handlers[handler];
+	}
+	out << "\n  },\n";
+
+	out << "  \"addresses\": [";
+	bool first{ true };
+	for (std::size_t address{ 0 }; address < counts.addresses.size(); ++address)
+	{
+		if (counts.addresses[address] == 0) continue;
+
+		std::uint16_t opcode{ opcodeAt(chip8, address) };
+		out << (first ? "\n" : ",\n") << "    { \"address\": \"" << hex(static_cast<unsigned>(address), 3)
+			<< "\", \"opcode\": \"" << hex(opcode, 4) << "\", \"instruction\": \""
+			<< Disassembler::disassemble(opcode, chip8.getPlatform()) << "\", \"count\": " << counts.addresses[address] << " }";
+		first = false;
+	}
+	out << "\n  ]\n}\n";
+}
+
+void Profiler::writeCsv(const Chip8& chip8, std::ostream& out)
+{
+	const Chip8::ExecutionProfile& counts{ chip8.executionProfile };
+
+	out << "kind,name,count\n"
+		<< "total,instructions," << chip8.getInstructionCount() << '\n'
+		<< "total,fast_forwarded," << counts.fastForwarded << '\n'
+		<< "total,fx0a_wait_instructions," << counts.keyWaitInstructions << '\n'
+		<< "total,dxyn_pixels_drawn," << counts.pixelsDrawn << '\n'
+		<< "total,dxyn_pixels_erased," << counts.pixelsErased << '\n'
+		<< "total,dxyn_collisions," << counts.collisions << '\n';
+
+	for (std::size_t handler{ 0 }; handler < counts.handlers.size(); ++handler)
+	{
+		out << "handler," << handlerName(handler) << ',' << counts.handlers[handler] << '\n';
+	}
+	for (std::size_t address{ 0 }; address < counts.addresses.size(); ++address)
+	{
+		if (counts.addresses[address] != 0)
+		{
+			out << "address," << hex(static_cast<unsigned>(address), 3) << ',' << counts.addresses[address] << '\n';
+		}
+	}
+}
+
+void Profiler::writeHeatmap(const Chip8& chip8, std::ostream& out)
+{
+	constexpr std::uint64_t BAR_WIDTH{ 40 };	// Characters in the busiest address's bar
+
+	const Chip8::ExecutionProfile& counts{ chip8.executionProfile };
+	std::uint64_t fetched{ std::accumulate(counts.addresses.begin(), counts.addresses.end(), std::uint64_t{ 0 }) };
+	std::uint64_t busiest{ *std::max_element(counts.addresses.begin(), counts.addresses.end()) };
+	std::size_t executedAddresses{ static_cast<std::size_t>(
+		std::count_if(counts.addresses.begin(), counts.addresses.end(), [](std::uint64_t count) { return count != 0; })) };
+
+	out << "; " << fetched << " instructions fetched from " << executedAddresses << " addresses, "
+		<< counts.fastForwarded << " more fast-forwarded\n"
+		<< "; Opcodes are as memory holds them now\n\n";
+
+	bool first{ true };
+	std::size_t previous{ 0 };
+	for (std::size_t address{ 0 }; address < counts.addresses.size(); ++address)
+	{
+		std::uint64_t count{ counts.addresses[address] };
+		if (count == 0) continue;
+
+		// Runs of straight-line code stay together, anything skipped over is marked
+		if (!first && address != previous + 2) out << "       ...\n";
+		first = false;
+		previous = address;
+
+		std::uint16_t opcode{ opcodeAt(chip8, address) };
+		double share{ 100.0 * static_cast<double>(count) / static_cast<double>(fetched) };
+		std::size_t bar{ static_cast<std::size_t>((count * BAR_WIDTH + busiest - 1) / busiest) };	// Rounded up, so any count shows
+
+		out << hex(static_cast<unsigned>(address), 3) << "  " << std::uppercase << std::hex << std::setw(4) << std::setfill('0')
+			<< opcode << std::dec << std::nouppercase << std::setfill(' ') << "  " << std::left << std::setw(22)
+			<< Disassembler::disassemble(opcode, chip8.getPlatform()) << std::right << std::setw(12) << count << std::fixed
+			<< std::setprecision(2) << std::setw(8) << share << "%  " << std::string(bar, '#') << '\n';
+	}
+}
+
+bool Profiler::write(const Chip8& chip8, const std::string& prefix)
+{
+	std::ofstream json{ prefix + ".json" };
+	std::ofstream csv{ prefix + ".csv" };
+	std::ofstream heatmap{ prefix + ".heatmap.txt" };
+	if (!json || !csv || !heatmap)
+	{
+		std::cout << "Failed to write the profile to " << prefix << ".*" << std::endl;
+		return false;
+	}
+
+	writeJson(chip8, json);
+	writeCsv(chip8, csv);
+	writeHeatmap(chip8, heatmap);
+	return true;
+}
+
+void Profiler::reset(Chip8& chip8)
+{
+	chip8.executionProfile = Chip8::ExecutionProfile{};
+}
+
+const char* Profiler::handlerName(std::size_t handler)
+{
+	static_assert(std::size(HANDLER_NAMES) == static_cast<std::size_t>(Chip8::Op::COUNT), "HANDLER_NAMES does not match Chip8::Op");
+	return (handler < std::size(HANDLER_NAMES)) ? HANDLER_NAMES[handler] : "unknown";
+}
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+#if defined(CHIP8_PROFILE)
+
+#include "Chip8.h"
+
+#include <ostream>
+#include <string>
+
+// Exports what a Chip8 has counted since it was created, in builds with CHIP8_PROFILE defined. It has to be defined
+// for every file that includes Chip8.h, since it changes the class. Without it this header declares nothing.
+class Profiler
+{
+public:
+	// Totals, every handler by name and every address executed at least once
+	static void writeJson(const Chip8& chip8, std::ostream& out);
+
+	// The same, one "kind,name,count" row each
+	static void writeCsv(const Chip8& chip8, std::ostream& out);
+
+	// Every address executed at least once, disassembled, with its count and a bar scaled to the busiest one
+	static void writeHeatmap(const Chip8& chip8, std::ostream& out);
+
+	// All three, to <prefix>.json, <prefix>.csv and <prefix>.heatmap.txt
+	static bool write(const Chip8& chip8, const std::string& prefix);
+
+	static void reset(Chip8& chip8);
+
+	// "opcode_8XY7" and the like, or "opcode_NOP" for opcodes the core ignores
+	static const char* handlerName(std::size_t handler);
+};
+
+#endif
@@ -1,6 +1,7 @@
 // Some rendering code from https://austinmorlan.com/posts/chip8_emulator/#the-platform-layer
 
 #include "Chip8.h"
+#include "DisplayExpander.h"
 #include "Renderer.h"
 #include <SDL.h>
 
@@ -39,17 +40,40 @@ Renderer::~Renderer()
 	SDL_Quit();
 }
 
-void Renderer::update(const Chip8::display_type& video, int pitch)
+void Renderer::update(const Chip8::framebuffer_type& framebuffer, std::uint32_t dirtyRows)
 {
-	SDL_UpdateTexture(m_texture, nullptr, video.data(), pitch);
+	constexpr int pitch{ sizeof(Chip8::display_type::value_type) * Chip8::DISPLAY_WIDTH };
+
+	if (dirtyRows == 0 && !m_exposed) return;
+	m_exposed = false;
+
+	// Upload each run of consecutive dirty rows as one rectangle
+	int row{ 0 };
+	while (row < Chip8::DISPLAY_HEIGHT)
+	{
+		if (!(dirtyRows & (std::uint32_t{ 1 } << row)))
+		{
+			++row;
+			continue;
+		}
+
+		int firstRow{ row };
+		while (row < Chip8::DISPLAY_HEIGHT && (dirtyRows & (std::uint32_t{ 1 } << row))) ++row;
+
+		SDL_Rect rows{ 0, firstRow, Chip8::DISPLAY_WIDTH, row - firstRow };
+		DisplayExpander::expandRows(framebuffer, m_pixels, firstRow, row - firstRow);
+		SDL_UpdateTexture(m_texture, &rows, m_pixels.data() + (firstRow * Chip8::DISPLAY_WIDTH), pitch);
+	}
+
 	SDL_RenderClear(m_renderer);
 	SDL_RenderCopy(m_renderer, m_texture, nullptr, nullptr);
 	SDL_RenderPresent(m_renderer);
 }
 
-bool Renderer::processInput(Chip8::keypad_type& keys)
+bool Renderer::processInput(Chip8::keypad_type& keys, Hotkeys& hotkeys)
 {
 	bool quit = false;
+	hotkeys = Hotkeys{};
 
 	SDL_Event e;
 	while (SDL_PollEvent(&e))
@@ -60,11 +84,18 @@ bool Renderer::processInput(Chip8::keypad_type& keys)
 			quit = true;
 			break;
 
+		case SDL_WINDOWEVENT:
+			if (e.window.event == SDL_WINDOWEVENT_EXPOSED) m_exposed = true;
+			break;
+
 		case SDL_KEYDOWN:
 		{
 			switch (e.key.keysym.sym)
 			{
 			case SDLK_ESCAPE:	quit = true;	break;
+			case SDLK_F5:		hotkeys.saveState = true;	break;
+			case SDLK_F9:		hotkeys.loadState = true;	break;
+			case SDLK_BACKSPACE:	m_rewinding = true;	break;
 			case SDLK_1:		keys[0x1] = 1;	break;
 			case SDLK_2:		keys[0x2] = 1;	break;
 			case SDLK_3:		keys[0x3] = 1;	break;
@@ -105,11 +136,24 @@ bool Renderer::processInput(Chip8::keypad_type& keys)
 			case SDLK_x:	keys[0x0] = 0;	break;
 			case SDLK_c:	keys[0xB] = 0;	break;
 			case SDLK_v:	keys[0xF] = 0;	break;
+			case SDLK_BACKSPACE:	m_rewinding = false;	break;
 			}
 		}
 		break;
 		}
 	}
 
+	hotkeys.rewind = m_rewinding;
+
 	return quit;
 }
+
+void Renderer::waitForInput()
+{
+	SDL_WaitEvent(nullptr);
+}
+
+void Renderer::waitForInput(int timeoutMs)
+{
+	SDL_WaitEventTimeout(nullptr, timeoutMs);
+}
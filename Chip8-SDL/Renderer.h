@@ -12,10 +12,26 @@ class Renderer
 	SDL_Window* m_window{};
 	SDL_Renderer* m_renderer{};
 	SDL_Texture* m_texture{};
+	Chip8::display_type m_pixels{};
+	bool m_exposed{ true };	// Window needs presenting again even if nothing was drawn
+	bool m_rewinding{ false };
 
 public:
+	// Emulator commands on function keys, set for the events handled by one processInput() call
+	struct Hotkeys
+	{
+		bool saveState{ false };	// F5
+		bool loadState{ false };	// F9
+		bool rewind{ false };		// Backspace, for as long as it is held
+	};
+
 	Renderer(const std::string title, int textureWidth, int textureHeight, int videoScale);
 	~Renderer();
-	void update(const Chip8::display_type& video, int pitch);
-	bool processInput(Chip8::keypad_type& keys);
+	// Uploads only the rows set in dirtyRows (see Chip8::getDirtyRows), and does nothing when none are
+	void update(const Chip8::framebuffer_type& framebuffer, std::uint32_t dirtyRows);
+	bool processInput(Chip8::keypad_type& keys, Hotkeys& hotkeys);
+	// Sleep until SDL has an event queued for processInput()
+	void waitForInput();
+	// The same, but for at most timeoutMs
+	void waitForInput(int timeoutMs);
 };
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include "RewindBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+RewindBuffer::RewindBuffer(std::size_t capacity)
+	: ring(capacity)
+{
+	// Runs only break at two or more unchanged bytes, which pay for the next run's lengths, so no entry is much
+	// bigger than the state itself
+	delta.resize(sizeof(Chip8::State) + (sizeof(Chip8::State) / 64) + 16);
+}
+
+void RewindBuffer::push(const Chip8& chip8)
+{
+	toBytes(chip8.fork(), current);
+	if (!hasNewest)
+	{
+		newest = current;
+		hasNewest = true;
+		return;
+	}
+
+	std::size_t length{ encode(newest, current) };
+	std::size_t entrySize{ length + (2 * LENGTH_BYTES) };
+	newest = current;
+
+	// A frame that can never fit only loses the history before it
+	if (entrySize > ring.size())
+	{
+		clear();
+		newest = current;
+		hasNewest = true;
+		return;
+	}
+
+	while (ring.size() - used < entrySize) dropOldest();
+
+	std::uint8_t lengthBytes[LENGTH_BYTES]{};
+	std::uint32_t storedLength{ static_cast<std::uint32_t>(length) };
+	std::memcpy(lengthBytes, &storedLength, LENGTH_BYTES);
+
+	std::size_t tail{ (head + used) % ring.size() };
+	write(tail, lengthBytes, LENGTH_BYTES);
+	write((tail + LENGTH_BYTES) % ring.size(), delta.data(), length);
+	write((tail + LENGTH_BYTES + length) % ring.size(), lengthBytes, LENGTH_BYTES);
+	used += entrySize;
+	++entryCount;
+}
+
+bool RewindBuffer::stepBack(Chip8& chip8)
+{
+	if (entryCount == 0) return false;
+
+	// The newest entry ends where the used region does, its length is in its last bytes
+	std::size_t end{ (head + used) % ring.size() };
+	std::size_t length{ readLength((end + ring.size() - LENGTH_BYTES) % ring.size()) };
+	std::size_t entrySize{ length + (2 * LENGTH_BYTES) };
+	std::size_t start{ (end + ring.size() - entrySize) % ring.size() };
+
+	read((start + LENGTH_BYTES) % ring.size(), delta.data(), length);
+	decode(length, newest);
+	used -= entrySize;
+	--entryCount;
+
+	Chip8::State state{};
+	std::memcpy(&state, newest.data(), sizeof(state));
+	chip8.restore(state);
+	return true;
+}
+
+void RewindBuffer::clear()
+{
+	head = 0;
+	used = 0;
+	entryCount = 0;
+	hasNewest = false;
+}
+
+void RewindBuffer::toBytes(const Chip8::State& state, snapshot_type& bytes)
+{
+	std::memcpy(bytes.data(), &state, sizeof(state));
+}
+
+// Runs of unchanged bytes are skipped, changed bytes are stored XORed with their old value.
+// Each run is <skip> <count> <count bytes>, both lengths as 7-bit varints.
+std::size_t RewindBuffer::encode(const snapshot_type& from, const snapshot_type& to)
+{
+	std::size_t length{ 0 };
+	auto putVarint = [this, &length](std::size_t value)
+	{
+		while (value >= 0x80)
+		{
+			delta[length++] = static_cast<std::uint8_t>(value | 0x80);
+			value >>= 7;
+		}
+		delta[length++] = static_cast<std::uint8_t>(value);
+	};
+
+	std::size_t position{ 0 };
+	while (position < from.size())
+	{
+		std::size_t changed{ position };
+		while (changed < from.size() && from[changed] == to[changed]) ++changed;
+		if (changed == from.size()) break;
+
+		// A literal run carries on over single unchanged bytes, a new run would cost more than they do
+		std::size_t runEnd{ changed };
+		while (runEnd < from.size())
+		{
+			if (from[runEnd] != to[runEnd])
+			{
+				++runEnd;
+			}
+			else if (runEnd + 1 < from.size() && from[runEnd + 1] != to[runEnd + 1])
+			{
+				runEnd += 2;
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		putVarint(changed - position);
+		putVarint(runEnd - changed);
+		for (std::size_t i{ changed }; i < runEnd; ++i)
+		{
+			delta[length++] = static_cast<std::uint8_t>(from[i] ^ to[i]);
+		}
+		position = runEnd;
+	}
+
+	return length;
+}
+
+void RewindBuffer::decode(std::size_t length, snapshot_type& bytes) const
+{
+	std::size_t offset{ 0 };
+	auto getVarint = [this, &offset]()
+	{
+		std::size_t value{ 0 };
+		int shift{ 0 };
+		std::uint8_t byte{};
+		do
+		{
+			byte = delta[offset++];
+			value |= static_cast<std::size_t>(byte & 0x7F) << shift;
+			shift += 7;
+		} while (byte & 0x80);
+		return value;
+	};
+
+	std::size_t position{ 0 };
+	while (offset < length)
+	{
+		position += getVarint();
+		std::size_t count{ getVarint() };
+		for (std::size_t i{ 0 }; i < count; ++i)
+		{
+			bytes[position++] ^= delta[offset++];
+		}
+	}
+}
+
+void RewindBuffer::write(std::size_t offset, const std::uint8_t* data, std::size_t length)
+{
+	std::size_t first{ std::min(length, ring.size() - offset) };
+	std::memcpy(ring.data() + offset, data, first);
+	std::memcpy(ring.data(), data + first, length - first);
+}
+
+void RewindBuffer::read(std::size_t offset, std::uint8_t* data, std::size_t length) const
+{
+	std::size_t first{ std::min(length, ring.size() - offset) };
+	std::memcpy(data, ring.data() + offset, first);
+	std::memcpy(data + first, ring.data(), length - first);
+}
+
+std::uint32_t RewindBuffer::readLength(std::size_t offset) const
+{
+	std::uint8_t lengthBytes[LENGTH_BYTES]{};
+	read(offset, lengthBytes, LENGTH_BYTES);
+
+	std::uint32_t length{};
+	std::memcpy(&length, lengthBytes, LENGTH_BYTES);
+	return length;
+}
+
+void RewindBuffer::dropOldest()
+{
+	std::size_t entrySize{ readLength(head) + (2 * LENGTH_BYTES) };
+	head = (head + entrySize) % ring.size();
+	used -= entrySize;
+	--entryCount;
+}